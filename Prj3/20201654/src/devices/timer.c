@@ -24,6 +24,15 @@ static int64_t ticks;
    Initialized by timer_calibrate(). */
 static unsigned loops_per_tick;
 
+/* Tickless idle.  Instead of taking an interrupt every tick, the
+   idle thread arms the PIT to fire once at the next deadline,
+   at most TIMER_IDLE_MAX_TICKS away. */
+bool timer_tickless;
+#define CYCLES_PER_TICK ((PIT_HZ + TIMER_FREQ / 2) / TIMER_FREQ)
+static int64_t idle_armed;      /* Ticks the PIT is armed for, or 0. */
+static int64_t idle_skipped;    /* Ticks skipped by the last arming. */
+static int64_t avoided_cnt;     /* Timer interrupts avoided. */
+
 static intr_handler_func timer_interrupt;
 static bool too_many_loops (unsigned loops);
 static void busy_wait (int64_t loops);
@@ -95,6 +104,62 @@ timer_sleep (int64_t ticks)
   thread_sleep(ticks + start);
 }
 
+/* Waits for an interrupt on behalf of the idle thread, arming the
+   timer to fire no later than tick DEADLINE rather than on every
+   tick.  Returns the number of ticks that passed without a timer
+   interrupt, which ticks has been caught up by.  Interrupts must
+   be turned off. */
+int64_t
+timer_idle (int64_t deadline) 
+{
+  int64_t armed = deadline - ticks;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (armed > TIMER_IDLE_MAX_TICKS)
+    armed = TIMER_IDLE_MAX_TICKS;
+  if (armed < 2)
+    {
+      /* Nothing to skip: wait for the next tick as usual. */
+      asm volatile ("sti; hlt" : : : "memory");
+      return 0;
+    }
+
+  pit_start_oneshot (0, armed * CYCLES_PER_TICK);
+  idle_armed = armed;
+  idle_skipped = 0;
+  asm volatile ("sti; hlt" : : : "memory");
+  intr_disable ();
+
+  if (idle_armed != 0)
+    {
+      /* Some other interrupt woke us up first.  Count the whole
+         ticks that have passed.  If the counter already ran out,
+         its interrupt is pending and will count the last one. */
+      int64_t left = pit_read_counter (0);
+      int64_t elapsed = (idle_armed * CYCLES_PER_TICK - left)
+                        / CYCLES_PER_TICK;
+      if (elapsed < 0 || elapsed >= idle_armed)
+        elapsed = idle_armed - 1;
+      ticks += elapsed;
+      idle_skipped = elapsed;
+      idle_armed = 0;
+      pit_configure_channel (0, 2, TIMER_FREQ);
+    }
+  avoided_cnt += idle_skipped;
+  return idle_skipped;
+}
+
+/* Returns the number of timer interrupts tickless idle avoided. */
+int64_t
+timer_idle_avoided (void) 
+{
+  enum intr_level old_level = intr_disable ();
+  int64_t avoided = avoided_cnt;
+  intr_set_level (old_level);
+  return avoided;
+}
+
 /* Sleeps for approximately MS milliseconds.  Interrupts must be
    turned on. */
 void
@@ -163,12 +228,23 @@ void
 timer_print_stats (void) 
 {
   printf ("Timer: %"PRId64" ticks\n", timer_ticks ());
+  if (timer_tickless)
+    printf ("Timer: %"PRId64" interrupts avoided while idle\n", avoided_cnt);
 }
 
 /* Timer interrupt handler. */
 static void
 timer_interrupt (struct intr_frame *args UNUSED)
 {
+  if (idle_armed != 0)
+    {
+      /* The tickless idle one-shot ran out after IDLE_ARMED ticks;
+         go back to a periodic interrupt. */
+      idle_skipped = idle_armed - 1;
+      ticks += idle_skipped;
+      idle_armed = 0;
+      pit_configure_channel (0, 2, TIMER_FREQ);
+    }
   ticks++;
   thread_tick ();
   thread_wakeup(ticks);
@@ -2,11 +2,22 @@
 #define DEVICES_TIMER_H
 
 #include <round.h>
+#include <stdbool.h>
 #include <stdint.h>
+#include "devices/pit.h"
 
 /* Number of timer interrupts per second. */
 #define TIMER_FREQ 100
 
+/* Most ticks tickless idle can skip with one interrupt, limited by
+   the PIT's 16-bit counter. */
+#define TIMER_IDLE_MAX_TICKS \
+  (UINT16_MAX / ((PIT_HZ + TIMER_FREQ / 2) / TIMER_FREQ))
+
+/* If true, skip timer interrupts while the CPU is idle.
+   Controlled by kernel command-line option "-tickless". */
+extern bool timer_tickless;
+
 void timer_init (void);
 void timer_calibrate (void);
 
@@ -18,6 +29,8 @@ void timer_sleep (int64_t ticks);
 void timer_msleep (int64_t milliseconds);
 void timer_usleep (int64_t microseconds);
 void timer_nsleep (int64_t nanoseconds);
+int64_t timer_idle (int64_t deadline);
+int64_t timer_idle_avoided (void);
 
 /* Busy waits. */
 void timer_mdelay (int64_t milliseconds);
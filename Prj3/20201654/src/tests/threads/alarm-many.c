@@ -0,0 +1,104 @@
+/* Puts thousands of threads to sleep at once and measures how
+   much CPU time the timer interrupt leaves to a busy thread while
+   they sleep.  Tick handling should not depend on the number of
+   sleeping threads, so the loop counts with and without sleepers
+   should be about the same.  Also checks that every sleeper
+   wakes up no earlier than requested. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define SLEEPER_CNT 2000        /* Number of sleeping threads. */
+#define MEASURE_TICKS 100       /* Length of each measurement. */
+
+struct sleeper
+  {
+    int64_t wakeup;             /* Tick to wake up at. */
+    int64_t woke;               /* Tick actually woken at. */
+    struct semaphore *done;     /* Upped when woken. */
+  };
+
+static thread_func sleeper;
+static int64_t busy_loop (void);
+
+void
+test_alarm_many (void) 
+{
+  struct sleeper *sleepers;
+  struct semaphore done;
+  int64_t start;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  msg ("0 sleepers: %"PRId64" loops in %d ticks",
+       busy_loop (), MEASURE_TICKS);
+
+  sleepers = malloc (sizeof *sleepers * SLEEPER_CNT);
+  if (sleepers == NULL)
+    PANIC ("couldn't allocate memory for test");
+  sema_init (&done, 0);
+
+  /* Each sleeper runs as soon as it is created and goes to sleep
+     until well after the measurement, spread over 64 ticks. */
+  start = timer_ticks ();
+  for (i = 0; i < SLEEPER_CNT; i++) 
+    {
+      struct sleeper *s = &sleepers[i];
+      char name[16];
+
+      s->wakeup = start + MEASURE_TICKS * 2 + i % 64;
+      s->done = &done;
+      snprintf (name, sizeof name, "sleeper %d", i);
+      if (thread_create (name, PRI_DEFAULT + 1, sleeper, s) == TID_ERROR)
+        fail ("thread_create() failed for sleeper %d", i);
+    }
+
+  msg ("%d sleepers: %"PRId64" loops in %d ticks",
+       SLEEPER_CNT, busy_loop (), MEASURE_TICKS);
+
+  for (i = 0; i < SLEEPER_CNT; i++)
+    sema_down (&done);
+  for (i = 0; i < SLEEPER_CNT; i++)
+    if (sleepers[i].woke < sleepers[i].wakeup)
+      fail ("sleeper %d woke up at tick %"PRId64", before tick %"PRId64,
+            i, sleepers[i].woke, sleepers[i].wakeup);
+  msg ("all sleepers woke up on time");
+
+  free (sleepers);
+}
+
+/* Spins for MEASURE_TICKS timer ticks and returns the number of
+   iterations completed. */
+static int64_t
+busy_loop (void) 
+{
+  int64_t start = timer_ticks ();
+  int64_t loops = 0;
+
+  /* Start at the beginning of a tick. */
+  while (timer_ticks () == start)
+    barrier ();
+
+  start = timer_ticks ();
+  while (timer_elapsed (start) < MEASURE_TICKS)
+    loops++;
+  return loops;
+}
+
+static void
+sleeper (void *s_) 
+{
+  struct sleeper *s = s_;
+
+  timer_sleep (s->wakeup - timer_ticks ());
+  s->woke = timer_ticks ();
+  sema_up (s->done);
+}
@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+foreach my $cnt (0, 2000) {
+    fail "missing timing for $cnt sleepers"
+      unless grep (/^\(alarm-many\) $cnt sleepers: \d+ loops in \d+ ticks$/,
+		   @output);
+}
+fail "missing wakeup check in output"
+  unless grep ($_ eq '(alarm-many) all sleepers woke up on time', @output);
+
+pass;
@@ -0,0 +1,77 @@
+/* Checks that sleeping threads still wake up in order and on
+   time when the timer skips ticks while the CPU is idle, and that
+   ticks were actually skipped.  Run with the -tickless kernel
+   option. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "devices/timer.h"
+
+#define SLEEPER_CNT 5
+
+struct sleeper
+  {
+    int id;                     /* Sleeper ID. */
+    int64_t wakeup;             /* Tick to wake up at. */
+    int64_t woke;               /* Tick actually woken at. */
+    struct semaphore *done;     /* Upped when woken. */
+  };
+
+static thread_func sleeper;
+
+void
+test_alarm_tickless (void) 
+{
+  struct sleeper sleepers[SLEEPER_CNT];
+  struct semaphore done;
+  int64_t start;
+  int i;
+
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  sema_init (&done, 0);
+  start = timer_ticks ();
+  for (i = 0; i < SLEEPER_CNT; i++) 
+    {
+      struct sleeper *s = &sleepers[i];
+      char name[16];
+
+      /* Deadlines many ticks apart, some not multiples of the
+         longest the timer can be armed for. */
+      s->id = i;
+      s->wakeup = start + (i + 1) * 37;
+      s->done = &done;
+      snprintf (name, sizeof name, "sleeper %d", i);
+      thread_create (name, PRI_DEFAULT + 1, sleeper, s);
+    }
+
+  for (i = 0; i < SLEEPER_CNT; i++)
+    sema_down (&done);
+  for (i = 0; i < SLEEPER_CNT; i++)
+    {
+      if (sleepers[i].woke < sleepers[i].wakeup)
+        fail ("sleeper %d woke up at tick %"PRId64", before tick %"PRId64,
+              i, sleepers[i].woke, sleepers[i].wakeup);
+      if (sleepers[i].woke > sleepers[i].wakeup + TIMER_IDLE_MAX_TICKS)
+        fail ("sleeper %d woke up at tick %"PRId64", too long after "
+              "tick %"PRId64, i, sleepers[i].woke, sleepers[i].wakeup);
+    }
+  if (timer_idle_avoided () == 0)
+    fail ("no timer interrupts were skipped while idle");
+}
+
+static void
+sleeper (void *s_) 
+{
+  struct sleeper *s = s_;
+
+  timer_sleep (s->wakeup - timer_ticks ());
+  s->woke = timer_ticks ();
+  msg ("Thread %d woke up.", s->id);
+  sema_up (s->done);
+}
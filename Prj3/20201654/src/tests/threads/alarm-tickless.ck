@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected ([<<'EOF']);
+(alarm-tickless) begin
+(alarm-tickless) Thread 0 woke up.
+(alarm-tickless) Thread 1 woke up.
+(alarm-tickless) Thread 2 woke up.
+(alarm-tickless) Thread 3 woke up.
+(alarm-tickless) Thread 4 woke up.
+(alarm-tickless) end
+EOF
+pass;
@@ -0,0 +1,80 @@
+/* Measures the cost of a context switch as the number of ready
+   threads grows.  Each phase creates a different number of
+   threads at the same priority and has them share a fixed total
+   number of thread_yield() calls, so every phase performs the
+   same number of context switches.  With per-priority run queues
+   the time taken by each phase should stay roughly the same no
+   matter how many threads are ready. */
+
+#include <inttypes.h>
+#include <stdio.h>
+#include "tests/threads/tests.h"
+#include "threads/init.h"
+#include "devices/timer.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+
+#define YIELD_CNT 40000         /* Context switches per phase. */
+
+struct phase_data
+  {
+    int yields;                 /* Yields each thread performs. */
+    struct semaphore done;      /* Upped by each finished thread. */
+  };
+
+static thread_func yield_thread;
+static void run_phase (int thread_cnt);
+
+void
+test_sched_many (void) 
+{
+  /* This test does not work with the MLFQS. */
+  ASSERT (!thread_mlfqs);
+
+  /* Make sure our priority is the default. */
+  ASSERT (thread_get_priority () == PRI_DEFAULT);
+
+  run_phase (2);
+  run_phase (20);
+  run_phase (200);
+}
+
+static void
+run_phase (int thread_cnt) 
+{
+  struct phase_data data;
+  int64_t start;
+  int i;
+
+  data.yields = YIELD_CNT / thread_cnt;
+  sema_init (&data.done, 0);
+
+  /* Create every thread before any of them runs. */
+  thread_set_priority (PRI_DEFAULT + 2);
+  for (i = 0; i < thread_cnt; i++) 
+    {
+      char name[24];
+      snprintf (name, sizeof name, "yield %d", i);
+      thread_create (name, PRI_DEFAULT + 1, yield_thread, &data);
+    }
+
+  /* The threads now run to termination here. */
+  start = timer_ticks ();
+  thread_set_priority (PRI_DEFAULT);
+  for (i = 0; i < thread_cnt; i++)
+    sema_down (&data.done);
+
+  msg ("%d threads: %d yields in %"PRId64" ticks",
+       thread_cnt, data.yields * thread_cnt, timer_elapsed (start));
+}
+
+static void
+yield_thread (void *data_) 
+{
+  struct phase_data *data = data_;
+  int i;
+
+  for (i = 0; i < data->yields; i++)
+    thread_yield ();
+  sema_up (&data->done);
+}
@@ -0,0 +1,20 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+
+our ($test);
+my (@output) = read_text_file ("$test.output");
+
+common_checks ("run", @output);
+
+@output = get_core_output ("run", @output);
+foreach my $cnt (2, 20, 200) {
+    fail "missing timing for $cnt threads"
+      unless grep (/^\(sched-many\) $cnt threads: \d+ yields in \d+ ticks$/,
+		   @output);
+}
+fail "missing end in output"
+  unless grep ($_ eq '(sched-many) end', @output);
+
+pass;
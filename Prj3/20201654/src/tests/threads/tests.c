@@ -17,6 +17,8 @@ static const struct test tests[] =
     {"alarm-priority", test_alarm_priority},
     {"alarm-zero", test_alarm_zero},
     {"alarm-negative", test_alarm_negative},
+    {"alarm-many", test_alarm_many},
+    {"alarm-tickless", test_alarm_tickless},
     {"priority-change", test_priority_change},
     {"priority-change-2", test_priority_change_2},
     {"priority-donate-one", test_priority_donate_one},
@@ -26,6 +28,7 @@ static const struct test tests[] =
     {"priority-donate-sema", test_priority_donate_sema},
     {"priority-donate-lower", test_priority_donate_lower},
     {"priority-donate-chain", test_priority_donate_chain},
+    {"sched-many", test_sched_many},
     {"priority-fifo", test_priority_fifo},
     {"priority-lifo", test_priority_lifo},
     {"priority-preempt", test_priority_preempt},
@@ -11,6 +11,8 @@ extern test_func test_alarm_simultaneous;
 extern test_func test_alarm_priority;
 extern test_func test_alarm_zero;
 extern test_func test_alarm_negative;
+extern test_func test_alarm_many;
+extern test_func test_alarm_tickless;
 extern test_func test_priority_change;
 extern test_func test_priority_change_2;
 extern test_func test_priority_donate_one;
@@ -20,6 +22,7 @@ extern test_func test_priority_donate_sema;
 extern test_func test_priority_donate_nest;
 extern test_func test_priority_donate_lower;
 extern test_func test_priority_donate_chain;
+extern test_func test_sched_many;
 extern test_func test_priority_fifo;
 extern test_func test_priority_lifo;
 extern test_func test_priority_preempt;
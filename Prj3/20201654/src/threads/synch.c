@@ -32,6 +32,12 @@
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 
+/* Maximum length of a chain of priority donations. */
+#define DONATION_DEPTH 8
+
+static void donate_priority (struct thread *);
+static void mlfqs_update_waiters (struct list *);
+
 /* Initializes semaphore SEMA to VALUE.  A semaphore is a
    nonnegative integer along with two atomic operators for
    manipulating it:
@@ -119,20 +125,32 @@ sema_up (struct semaphore *sema)
 
   old_level = intr_disable ();
   if (!list_empty (&sema->waiters)) {
+    if (thread_mlfqs)
+      mlfqs_update_waiters (&sema->waiters);
     list_sort(&sema->waiters, compare_priority, NULL);
     thread_unblock (list_entry (list_pop_front (&sema->waiters),
                                 struct thread, elem));
   }
   sema->value++;
   // If the current thread has a lower priority than the highest priority thread in the ready list, yield the CPU to the highest priority thread
-  if(!list_empty(get_ready_list()))
-  {
-    if(thread_get_priority() < list_entry(list_front((get_ready_list())), struct thread, elem)->priority) {
+  if(thread_get_priority() < thread_max_ready_priority()) {
     thread_yield();
-  }}
+  }
   intr_set_level (old_level);
 }
 
+/* Brings the MLFQS priorities of the threads in WAITERS up to
+   date.  Blocked threads skip recent_cpu decay until they are
+   looked at, so do that before choosing among them. */
+static void
+mlfqs_update_waiters (struct list *waiters)
+{
+  struct list_elem *e;
+
+  for (e = list_begin (waiters); e != list_end (waiters); e = list_next (e))
+    thread_mlfqs_update (list_entry (e, struct thread, elem));
+}
+
 static void sema_test_helper (void *sema_);
 
 /* Self-test for semaphores that makes control "ping-pong"
@@ -205,12 +223,46 @@ lock_init (struct lock *lock)
 void
 lock_acquire (struct lock *lock)
 {
+  struct thread *cur = thread_current ();
+  enum intr_level old_level;
+
   ASSERT (lock != NULL);
   ASSERT (!intr_context ());
   ASSERT (!lock_held_by_current_thread (lock));
 
+  old_level = intr_disable ();
+  if (lock->holder != NULL && !thread_mlfqs)
+    {
+      cur->waiting_lock = lock;
+      donate_priority (cur);
+    }
   sema_down (&lock->semaphore);
-  lock->holder = thread_current ();
+  cur->waiting_lock = NULL;
+  lock->holder = cur;
+  list_push_back (&cur->locks, &lock->elem);
+  intr_set_level (old_level);
+}
+
+/* Lends T's priority to the holder of the lock T is waiting for,
+   and on down the chain of holders that are themselves waiting
+   for locks, for at most DONATION_DEPTH links. */
+static void
+donate_priority (struct thread *t)
+{
+  int depth;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (depth = 0; depth < DONATION_DEPTH && t->waiting_lock != NULL;
+       depth++)
+    {
+      struct thread *holder = t->waiting_lock->holder;
+
+      if (holder == NULL || holder->priority >= t->priority)
+        break;
+      thread_donate_priority (holder, t->priority);
+      t = holder;
+    }
 }
 
 /* Tries to acquires LOCK and returns true if successful or false
@@ -222,14 +274,20 @@ lock_acquire (struct lock *lock)
 bool
 lock_try_acquire (struct lock *lock)
 {
+  enum intr_level old_level;
   bool success;
 
   ASSERT (lock != NULL);
   ASSERT (!lock_held_by_current_thread (lock));
 
+  old_level = intr_disable ();
   success = sema_try_down (&lock->semaphore);
   if (success)
-    lock->holder = thread_current ();
+    {
+      lock->holder = thread_current ();
+      list_push_back (&lock->holder->locks, &lock->elem);
+    }
+  intr_set_level (old_level);
   return success;
 }
 
@@ -241,11 +299,20 @@ lock_try_acquire (struct lock *lock)
 void
 lock_release (struct lock *lock) 
 {
+  enum intr_level old_level;
+
   ASSERT (lock != NULL);
   ASSERT (lock_held_by_current_thread (lock));
 
+  /* Give back whatever was donated through LOCK before waking
+     its next holder, so sema_up() yields to it if needed. */
+  old_level = intr_disable ();
+  list_remove (&lock->elem);
   lock->holder = NULL;
+  if (!thread_mlfqs)
+    thread_refresh_priority (thread_current ());
   sema_up (&lock->semaphore);
+  intr_set_level (old_level);
 }
 
 /* Returns true if the current thread holds LOCK, false
@@ -336,6 +403,15 @@ cond_signal (struct condition *cond, struct lock *lock UNUSED)
   ASSERT (lock_held_by_current_thread (lock));
 
   if (!list_empty (&cond->waiters)) {
+    if (thread_mlfqs) {
+      struct list_elem *e;
+      enum intr_level old_level = intr_disable ();
+
+      for (e = list_begin (&cond->waiters); e != list_end (&cond->waiters);
+           e = list_next (e))
+        mlfqs_update_waiters (&list_entry (e, struct semaphore_elem, elem)->semaphore.waiters);
+      intr_set_level (old_level);
+    }
     list_sort(&cond->waiters, compare_priority_with_sema, NULL);
     sema_up (&list_entry (list_pop_front (&cond->waiters), struct semaphore_elem, elem)->semaphore);
   }
@@ -2,11 +2,13 @@
 #include <debug.h>
 #include <stddef.h>
 #include <random.h>
+#include <round.h>
 #include <stdio.h>
 #include <string.h>
 #include "threads/flags.h"
 #include "threads/interrupt.h"
 #include "threads/intr-stubs.h"
+#include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/switch.h"
 #include "threads/synch.h"
@@ -22,16 +24,50 @@ bool thread_prior_aging;
 #endif
 
 int load_avg;
-/* List of process in THREAD_BLOCKED state*/
-static struct list sleep_list;
 
-/* List of processes in THREAD_READY state, that is, processes
-   that are ready to run but not actually running. */
-static struct list ready_list;
+/* recent_cpu decays once a second.  Only the running and ready
+   threads are decayed on time; a blocked thread catches up on the
+   decays it missed when it is next looked at, using the factors
+   of the last DECAY_HISTORY seconds kept here.  decay_epoch counts
+   the decays so far.
+
+   So that no thread falls further behind than that, decay_cursor
+   walks all_list and catches up about 1/DECAY_HISTORY of the
+   threads each second, plus any thread it last passed
+   DECAY_HISTORY seconds ago.  New threads go in just behind the
+   cursor, so it meets the threads in the order it last passed
+   them. */
+#define DECAY_HISTORY 64
+static int decay_factors[DECAY_HISTORY];
+static int64_t decay_epoch;
+static struct list_elem *decay_cursor;
+
+/* Threads that priority aging still has to raise, that is, whose
+   priority or base priority is below PRI_MAX.  Every other thread
+   is already at the top, so each tick only visits these. */
+static struct list aging_list;
+/* Sleeping threads, kept as a binary min-heap on wakeup_tick so
+   the earliest deadline is always sleepers[0].  next_wakeup caches
+   that deadline (INT64_MAX if nobody sleeps), letting the timer
+   interrupt return at once until something is due. */
+static struct thread **sleepers;
+static size_t sleeper_cnt;      /* Number of sleeping threads. */
+static size_t sleeper_cap;      /* Number of slots in sleepers. */
+static int64_t next_wakeup = INT64_MAX;
+
+/* Processes in THREAD_READY state, that is, processes that are
+   ready to run but not actually running, with one FIFO queue per
+   priority.  Bit P of ready_levels is set if ready_queues[P] is
+   not empty, so the highest ready priority is found with a single
+   find-last-set on each of the two words. */
+static struct list ready_queues[PRI_MAX + 1];
+static uint32_t ready_levels[(PRI_MAX + 32) / 32];
+static size_t ready_cnt;        /* Number of ready threads. */
 
 /* List of all processes.  Processes are added to this list
    when they are first scheduled and removed when they exit. */
 static struct list all_list;
+static size_t all_cnt;          /* Number of threads in all_list. */
 
 /* Random value for struct thread's `magic' member.
    Used to detect stack overflow.  See the big comment at the top
@@ -80,6 +116,16 @@ static void *alloc_frame (struct thread *, size_t size);
 static void schedule (void);
 void thread_schedule_tail (struct thread *prev);
 static tid_t allocate_tid (void);
+static void grow_sleepers (void);
+static void sleepers_push (struct thread *);
+static struct thread *sleepers_pop (void);
+static void ready_push (struct thread *);
+static void ready_remove (struct thread *);
+static struct thread *ready_pop (void);
+static void set_priority (struct thread *, int priority);
+static bool tickless_idle (void);
+static void aging_track (struct thread *);
+static int mlfqs_priority (struct thread *);
 
 /* Initializes the threading system by transforming the code
    that's currently running into a thread.  This can't work in
@@ -97,12 +143,16 @@ static tid_t allocate_tid (void);
 void
 thread_init (void) 
 {
+  int i;
+
   ASSERT (intr_get_level () == INTR_OFF);
 
   lock_init (&tid_lock);
-  list_init (&sleep_list);
-  list_init (&ready_list);
+  for (i = 0; i <= PRI_MAX; i++)
+    list_init (&ready_queues[i]);
   list_init (&all_list);
+  decay_cursor = list_end (&all_list);
+  list_init (&aging_list);
   /* Set up a thread structure for the running thread. */
   initial_thread = running_thread ();
 
@@ -165,7 +215,7 @@ thread_tick (void)
       thread_current()->recent_cpu = add_x_to_n(thread_current()->recent_cpu, 1);
     }
 
-    // recaclulate load_avg, recent_cpu of all threads, priority every 1 second
+    // recaclulate load_avg, recent_cpu of running and ready threads every 1 second
     if (ticks % TIMER_FREQ == 0) {
       // recalculate load_avg
       recalculate_load_avg();
@@ -250,7 +300,7 @@ thread_create (const char *name, int priority,
   /* Compare the priorities of the currently running thread and the newly
      created thread. If the newly created thread has a higher priority, yield
      the CPU to the new thread. */
-  if (!list_empty(&ready_list) && list_entry(list_front(&ready_list), struct thread, elem)->priority > thread_get_priority()) {
+  if (thread_max_ready_priority() > thread_get_priority()) {
     thread_yield();
   }
   return tid;
@@ -289,7 +339,9 @@ thread_unblock (struct thread *t)
 
   old_level = intr_disable ();
   ASSERT (t->status == THREAD_BLOCKED);
-  list_insert_ordered(&ready_list, &t->elem, (list_less_func *) &compare_priority, NULL);
+  if (thread_mlfqs)
+    thread_mlfqs_update (t);
+  ready_push (t);
   t->status = THREAD_READY;
   intr_set_level (old_level);
 }
@@ -341,36 +393,105 @@ void thread_sleep(int64_t ticks) {
     intr_set_level(old_level);
     return;
   }
+  // The heap can only grow with interrupts on, so make room first
+  while (sleeper_cnt == sleeper_cap) {
+    intr_set_level(old_level);
+    grow_sleepers();
+    old_level = intr_disable();
+  }
   t->status = THREAD_BLOCKED;
   t->wakeup_tick = ticks;
-  list_push_back(&sleep_list, &t->elem);
+  sleepers_push(t);
   schedule();
 
   // Enable interrupts
   intr_set_level(old_level);
 }
 
+/* Wakes up every thread whose wakeup tick has passed.  Called by
+   the timer interrupt handler, so it does no work unless the
+   earliest deadline is due. */
 void thread_wakeup(int64_t ticks){
-  struct list_elem *e = list_begin(&sleep_list);
-  struct thread *t;
-  while (e != list_end(&sleep_list)) {
-    t = list_entry(e, struct thread, elem);
-    if (t->wakeup_tick <= ticks) {
-      e = list_remove(e);
-      thread_unblock(t);
-    }
-    else {
-      e = list_next(e);
-    }
+  if (ticks < next_wakeup)
+    return;
+  while (sleeper_cnt > 0 && sleepers[0]->wakeup_tick <= ticks)
+    thread_unblock(sleepers_pop());
+  next_wakeup = sleeper_cnt > 0 ? sleepers[0]->wakeup_tick : INT64_MAX;
+}
+
+/* Doubles the capacity of the sleepers heap.  The new array is
+   allocated with interrupts on and swapped in with interrupts
+   off, since the timer interrupt may pop from the heap at any
+   time. */
+static void grow_sleepers(void) {
+  size_t cap = sleeper_cap > 0 ? sleeper_cap * 2 : 64;
+  struct thread **new = malloc(cap * sizeof *new);
+  struct thread **old = new;
+  enum intr_level old_level;
+
+  if (new == NULL)
+    PANIC("out of memory for sleeping threads");
+
+  old_level = intr_disable();
+  if (cap > sleeper_cap) {
+    memcpy(new, sleepers, sleeper_cnt * sizeof *new);
+    old = sleepers;
+    sleepers = new;
+    sleeper_cap = cap;
   }
+  intr_set_level(old_level);
+  free(old);
 }
 
-struct list *get_ready_list(void) {
-  return &ready_list;
+/* Adds T to the sleepers heap, which must have a free slot. */
+static void sleepers_push(struct thread *t) {
+  size_t i = sleeper_cnt++;
+
+  ASSERT(i < sleeper_cap);
+  while (i > 0 && sleepers[(i - 1) / 2]->wakeup_tick > t->wakeup_tick) {
+    sleepers[i] = sleepers[(i - 1) / 2];
+    i = (i - 1) / 2;
+  }
+  sleepers[i] = t;
+  if (t->wakeup_tick < next_wakeup)
+    next_wakeup = t->wakeup_tick;
 }
 
-struct list *get_sleep_list(void) {
-  return &sleep_list;
+/* Removes and returns the thread with the earliest wakeup tick
+   from the sleepers heap, which must not be empty. */
+static struct thread *sleepers_pop(void) {
+  struct thread *min = sleepers[0];
+  struct thread *last;
+  size_t i = 0;
+
+  ASSERT(sleeper_cnt > 0);
+  last = sleepers[--sleeper_cnt];
+  for (;;) {
+    size_t child = 2 * i + 1;
+    if (child >= sleeper_cnt)
+      break;
+    if (child + 1 < sleeper_cnt
+        && sleepers[child + 1]->wakeup_tick < sleepers[child]->wakeup_tick)
+      child++;
+    if (sleepers[child]->wakeup_tick >= last->wakeup_tick)
+      break;
+    sleepers[i] = sleepers[child];
+    i = child;
+  }
+  sleepers[i] = last;
+  return min;
+}
+
+/* Returns the highest priority of any ready thread, or PRI_MIN - 1
+   if no thread is ready.  Must be called with interrupts off or
+   from an interrupt handler. */
+int thread_max_ready_priority(void) {
+  int i;
+
+  for (i = (int) (sizeof ready_levels / sizeof *ready_levels) - 1; i >= 0; i--)
+    if (ready_levels[i] != 0)
+      return i * 32 + 31 - __builtin_clz(ready_levels[i]);
+  return PRI_MIN - 1;
 }
 
 struct list *get_all_list(void) {
@@ -381,19 +502,37 @@ struct thread *get_idle_thread(void) {
 }
 // src/threads/thread.c
 void thread_aging(void) {
-  struct list_elem *e = list_begin(&all_list);
+  struct list_elem *e = list_begin(&aging_list);
   struct thread *t;
-  while (e != list_end(&all_list)) {
-    t = list_entry(e, struct thread, allelem);
+  while (e != list_end(&aging_list)) {
+    t = list_entry(e, struct thread, agingelem);
+    if (t->base_priority < PRI_MAX) {
+      t->base_priority++;
+    }
     if (t->priority < PRI_MAX) {
-      t->priority++;
+      set_priority(t, t->priority + 1);
+    }
+    // Nothing left to raise until its priority drops again
+    if (t->base_priority == PRI_MAX && t->priority == PRI_MAX) {
+      e = list_remove(e);
+      t->aging = false;
+    }
+    else {
+      e = list_next(e);
     }
-    e = list_next(e);
-  }
-  if (t->priority < PRI_MIN) {
-    t->priority = PRI_MIN;
   }
 }
+
+/* Adds T to the aging list if its priority can still be raised. */
+static void
+aging_track (struct thread *t)
+{
+  if (!t->aging && (t->priority < PRI_MAX || t->base_priority < PRI_MAX))
+    {
+      list_push_back (&aging_list, &t->agingelem);
+      t->aging = true;
+    }
+}
 /* Deschedules the current thread and destroys it.  Never
    returns to the caller. */
 void
@@ -409,7 +548,12 @@ thread_exit (void)
      and schedule another process.  That process will destroy us
      when it calls thread_schedule_tail(). */
   intr_disable ();
+  if (decay_cursor == &thread_current ()->allelem)
+    decay_cursor = list_next (decay_cursor);
   list_remove (&thread_current()->allelem);
+  all_cnt--;
+  if (thread_current ()->aging)
+    list_remove (&thread_current ()->agingelem);
   thread_current ()->status = THREAD_DYING;
   schedule ();
   NOT_REACHED ();
@@ -427,7 +571,12 @@ thread_yield (void)
 
   old_level = intr_disable ();
   if (cur != idle_thread) 
-    list_insert_ordered(&ready_list, &cur->elem, (list_less_func *) &compare_priority, NULL);
+    {
+      /* Account for the CPU time used since the last update. */
+      if (thread_mlfqs)
+        set_priority (cur, mlfqs_priority (cur));
+      ready_push (cur);
+    }
   cur->status = THREAD_READY;
   schedule ();
   intr_set_level (old_level);
@@ -454,11 +603,60 @@ thread_foreach (thread_action_func *func, void *aux)
 void
 thread_set_priority (int new_priority) 
 {
-  // Reorder the ready list based on the new priority
-  int old_priority = thread_current()->priority;
-  thread_current()->priority = new_priority;
+  struct thread *cur = thread_current ();
+  enum intr_level old_level = intr_disable ();
+
+  // Donations still apply on top of the new base priority
+  cur->base_priority = new_priority;
+  if (thread_mlfqs)
+    cur->priority = new_priority;
+  else
+    thread_refresh_priority (cur);
+
+  if (thread_max_ready_priority () > cur->priority)
+    thread_yield ();
+  intr_set_level (old_level);
+}
+
+/* Raises T's priority to PRIORITY, if it is lower, on behalf of
+   a thread waiting for a lock T holds.  Must be called with
+   interrupts off. */
+void
+thread_donate_priority (struct thread *t, int priority) 
+{
+  ASSERT (intr_get_level () == INTR_OFF);
 
-  if (new_priority < old_priority) thread_yield();
+  if (priority > t->priority)
+    set_priority (t, priority);
+}
+
+/* Recomputes T's priority as the highest of its base priority and
+   the priorities of the threads waiting for locks it holds, and
+   moves T to the matching run queue if it is ready.  Must be
+   called with interrupts off. */
+void
+thread_refresh_priority (struct thread *t) 
+{
+  int priority = t->base_priority;
+  struct list_elem *e, *w;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  for (e = list_begin (&t->locks); e != list_end (&t->locks);
+       e = list_next (e))
+    {
+      struct lock *lock = list_entry (e, struct lock, elem);
+      struct list *waiters = &lock->semaphore.waiters;
+
+      for (w = list_begin (waiters); w != list_end (waiters);
+           w = list_next (w))
+        {
+          struct thread *waiter = list_entry (w, struct thread, elem);
+          if (waiter->priority > priority)
+            priority = waiter->priority;
+        }
+    }
+  set_priority (t, priority);
 }
 
 /* Returns the current thread's priority. */
@@ -475,25 +673,11 @@ thread_set_nice (int nice UNUSED)
   thread_current()->nice = nice;
   
   if(thread_current() != idle_thread){
-    int p = add_x_to_y(integer_to_fp(PRI_MAX), div_x_by_n(thread_current()->recent_cpu, -4));
-    p = add_x_to_y(p, integer_to_fp(-2 * (thread_current()->nice)));
-    thread_current()->priority = fp_to_integer(p);
-    if (thread_current()->priority > PRI_MAX) {
-      thread_current()->priority = PRI_MAX;
-    }
-    else if (thread_current()->priority < PRI_MIN) {
-      thread_current()->priority = PRI_MIN;
-    }
-
+    set_priority(thread_current(), mlfqs_priority(thread_current()));
   }
 
-  if(!list_empty(&ready_list)){
-
-    struct list_elem* e=list_front(&ready_list);
-    struct thread *t = list_entry(e, struct thread, elem);
-    if(t->priority > thread_get_priority()){
-      thread_yield();
-    }
+  if(thread_max_ready_priority() > thread_get_priority()){
+    thread_yield();
   }
 }
 
@@ -551,11 +735,30 @@ idle (void *idle_started_ UNUSED)
          time.
 
          See [IA32-v2a] "HLT", [IA32-v2b] "STI", and [IA32-v3a]
-         7.11.1 "HLT Instruction". */
-      asm volatile ("sti; hlt" : : : "memory");
+         7.11.1 "HLT Instruction".
+
+         In tickless mode timer_idle() does the same, but lets the
+         timer skip ticks until the next thread is due to wake. */
+      if (tickless_idle ())
+        idle_ticks += timer_idle (next_wakeup);
+      else
+        asm volatile ("sti; hlt" : : : "memory");
     }
 }
 
+/* Returns true if the idle thread may let the timer skip ticks.
+   The MLFQS and priority aging update threads on every tick, so
+   they keep the periodic timer. */
+static bool
+tickless_idle (void) 
+{
+#ifndef USERPROG
+  if (thread_prior_aging)
+    return false;
+#endif
+  return timer_tickless && !thread_mlfqs;
+}
+
 /* Function used as the basis for a kernel thread. */
 static void
 kernel_thread (thread_func *function, void *aux) 
@@ -604,13 +807,19 @@ init_thread (struct thread *t, const char *name, int priority)
   strlcpy (t->name, name, sizeof t->name);
   t->stack = (uint8_t *) t + PGSIZE;
   t->priority = priority;
+  t->base_priority = priority;
+  list_init (&t->locks);
   t->magic = THREAD_MAGIC;
   //initialize nice, recent_cpu
   t->nice = 0;
   t->recent_cpu = 0;
+  t->decay_epoch = decay_epoch;
+  t->decay_visit = decay_epoch;
 
   old_level = intr_disable ();
-  list_push_back (&all_list, &t->allelem);
+  list_insert (decay_cursor, &t->allelem);
+  all_cnt++;
+  aging_track (t);
   intr_set_level (old_level);
 
   // #ifdef USERPROG
@@ -640,10 +849,59 @@ alloc_frame (struct thread *t, size_t size)
 static struct thread *
 next_thread_to_run (void) 
 {
-  if (list_empty (&ready_list))
+  if (ready_cnt == 0)
     return idle_thread;
   else
-    return list_entry (list_pop_front (&ready_list), struct thread, elem);
+    return ready_pop ();
+}
+
+/* Appends T to the run queue of its priority. */
+static void
+ready_push (struct thread *t)
+{
+  list_push_back (&ready_queues[t->priority], &t->elem);
+  ready_levels[t->priority / 32] |= 1u << (t->priority % 32);
+  ready_cnt++;
+}
+
+/* Removes T from its run queue. */
+static void
+ready_remove (struct thread *t)
+{
+  list_remove (&t->elem);
+  if (list_empty (&ready_queues[t->priority]))
+    ready_levels[t->priority / 32] &= ~(1u << (t->priority % 32));
+  ready_cnt--;
+}
+
+/* Removes and returns the first thread of the highest priority
+   run queue, which must not be empty. */
+static struct thread *
+ready_pop (void)
+{
+  int priority = thread_max_ready_priority ();
+  struct thread *t;
+
+  ASSERT (priority >= PRI_MIN);
+  t = list_entry (list_front (&ready_queues[priority]), struct thread, elem);
+  ready_remove (t);
+  return t;
+}
+
+/* Sets T's priority to PRIORITY, moving T to the matching run
+   queue if it is ready and its priority changes. */
+static void
+set_priority (struct thread *t, int priority)
+{
+  if (t->status == THREAD_READY && t->priority != priority)
+    {
+      ready_remove (t);
+      t->priority = priority;
+      ready_push (t);
+    }
+  else
+    t->priority = priority;
+  aging_track (t);
 }
 
 /* Completes a thread switch by activating the new thread's page
@@ -754,7 +1012,7 @@ void init_userprog(struct thread *t) {
 
 void recalculate_load_avg(void){
   // recalculate load_avg
-  int ready_threads = list_size(&ready_list);
+  int ready_threads = ready_cnt;
   if (thread_current() != idle_thread) ready_threads++;
 
   int temp = mul_x_by_y(div_x_by_y(integer_to_fp(59), integer_to_fp(60)), load_avg);
@@ -764,40 +1022,79 @@ void recalculate_load_avg(void){
 
 // recalculate recent_cpu
 void recalculate_recent_cpu(void){
-  struct list_elem *e = list_begin(&all_list);
+  struct list_elem *e, *next;
   struct thread *t;
-  while (e != list_end(&all_list)) {
-    t = list_entry(e, struct thread, allelem);
-    if (t != idle_thread) {
-      int recent_cpu = mul_x_by_n(load_avg, 2);
-      int temp = div_x_by_y(recent_cpu, add_x_to_n(recent_cpu, 1));
-      temp = add_x_to_n(mul_x_by_y(temp, t->recent_cpu), t->nice);
-      t->recent_cpu = temp;
+  size_t quota;
+  int i;
+
+  // record this second's decay factor for threads that catch up later
+  int recent_cpu = mul_x_by_n(load_avg, 2);
+  decay_factors[decay_epoch % DECAY_HISTORY] = div_x_by_y(recent_cpu, add_x_to_n(recent_cpu, 1));
+  decay_epoch++;
+
+  // catch up the next slice of threads, and every thread the cursor
+  // passed DECAY_HISTORY seconds ago, before its oldest factor is
+  // overwritten
+  quota = DIV_ROUND_UP(all_cnt, DECAY_HISTORY);
+  while (all_cnt > 0) {
+    if (decay_cursor == list_end(&all_list))
+      decay_cursor = list_begin(&all_list);
+    t = list_entry(decay_cursor, struct thread, allelem);
+    if (quota == 0 && decay_epoch - t->decay_visit < DECAY_HISTORY)
+      break;
+    if (quota > 0)
+      quota--;
+    thread_mlfqs_update(t);
+    t->decay_visit = decay_epoch;
+    decay_cursor = list_next(decay_cursor);
+  }
+
+  // other blocked threads wait until they are unblocked
+  thread_mlfqs_update(thread_current());
+  for (i = PRI_MIN; i <= PRI_MAX; i++) {
+    // a thread moved to a later queue is already up to date
+    for (e = list_begin(&ready_queues[i]); e != list_end(&ready_queues[i]); e = next) {
+      next = list_next(e);
+      thread_mlfqs_update(list_entry(e, struct thread, elem));
     }
-    e = list_next(e);
   }
 }
 
 // recalculate priority
 void recalculate_priority(void){
-  struct list_elem *e = list_begin(&all_list);
-  struct thread *t;
-  while (e != list_end(&all_list)) {
-    t = list_entry(e, struct thread, allelem);
-    // if the thread is not idle thread, recalculate priority
-    if (t != idle_thread) {
-      int p = sub_y_from_x(integer_to_fp(PRI_MAX), div_x_by_n(t->recent_cpu, 4));
-      p = sub_y_from_x(p, integer_to_fp((t->nice) * 2));
-      t->priority = fp_to_integer(p);
-      if (t->priority > PRI_MAX) t->priority = PRI_MAX;        
-      else if (t->priority < PRI_MIN) t->priority = PRI_MIN;
-    }
-    e = list_next(e);
+  // only the running thread's recent_cpu changed since the last time
+  if (thread_current() != idle_thread) {
+    set_priority(thread_current(), mlfqs_priority(thread_current()));
+  }
+
+  // 준비된 thread 중 가장 높은 priority가 더 높으면 yield
+  if (thread_max_ready_priority() > thread_get_priority()) intr_yield_on_return();
+}
+
+/* Applies the recent_cpu decays T has missed and recomputes its
+   priority. */
+void thread_mlfqs_update(struct thread *t){
+  int64_t epoch;
+
+  ASSERT (intr_get_level () == INTR_OFF);
+
+  if (t == idle_thread) return;
+  epoch = t->decay_epoch;
+  ASSERT (decay_epoch - epoch <= DECAY_HISTORY);
+  for (; epoch < decay_epoch; epoch++) {
+    int temp = mul_x_by_y(decay_factors[epoch % DECAY_HISTORY], t->recent_cpu);
+    t->recent_cpu = add_x_to_n(temp, t->nice);
   }
+  t->decay_epoch = decay_epoch;
+  set_priority(t, mlfqs_priority(t));
+}
 
-  if(list_empty(&ready_list)) return;
-  e = list_front(&ready_list);
-  t = list_entry(e, struct thread, elem);
-  // ready_list의 제일 앞에 있는 thread의 priority가 더 높으면 yield
-  if (t->priority > thread_get_priority()) intr_yield_on_return();
+/* Returns T's MLFQS priority for its current recent_cpu and nice. */
+static int mlfqs_priority(struct thread *t){
+  int p = sub_y_from_x(integer_to_fp(PRI_MAX), div_x_by_n(t->recent_cpu, 4));
+  p = sub_y_from_x(p, integer_to_fp((t->nice) * 2));
+  p = fp_to_integer(p);
+  if (p > PRI_MAX) p = PRI_MAX;
+  else if (p < PRI_MIN) p = PRI_MIN;
+  return p;
 }
\ No newline at end of file
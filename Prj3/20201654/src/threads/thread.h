@@ -21,8 +21,6 @@ enum thread_status
     THREAD_BLOCKED,     /* Waiting for an event to trigger. */
     THREAD_DYING        /* About to be destroyed. */
   };
-// struct list sleep_list;
-// struct list ready_list;
 // struct list all_list;
 /* Thread identifier type.
    You can redefine this to whatever type you like. */
@@ -97,11 +95,14 @@ struct thread
     enum thread_status status;          /* Thread state. */
     char name[16];                      /* Name (for debugging purposes). */
     uint8_t *stack;                     /* Saved stack pointer. */
-    int priority;                       /* Priority. */
+    int priority;                       /* Priority, including donations. */
+    int base_priority;                  /* Priority before donations. */
     struct list_elem allelem;           /* List element for all threads list. */
 
     /* Shared between thread.c and synch.c. */
     struct list_elem elem;              /* List element. */
+    struct list locks;                  /* Locks held, for donation. */
+    struct lock *waiting_lock;          /* Lock being waited for. */
     int64_t wakeup_tick;
     /* Exit Status */
     int exit_status;
@@ -123,6 +124,11 @@ struct thread
 #endif
     int nice;
     int recent_cpu;
+    int64_t decay_epoch;                /* Seconds of decay in recent_cpu. */
+    int64_t decay_visit;                /* decay_epoch when decay_cursor
+                                           last passed. */
+    struct list_elem agingelem;         /* Element in aging list. */
+    bool aging;                         /* In aging list? */
     /* Owned by thread.c. */
     unsigned magic;                     /* Detects stack overflow. */
   };
@@ -151,8 +157,7 @@ const char *thread_name (void);
 
 void thread_sleep (int64_t ticks);
 void thread_wakeup (int64_t ticks);
-struct list* get_sleep_list(void);
-struct list* get_ready_list(void);
+int thread_max_ready_priority(void);
 struct list* get_all_list(void);
 struct thread* get_idle_thread(void);
 void thread_exit (void) NO_RETURN;
@@ -164,6 +169,8 @@ void thread_foreach (thread_action_func *, void *);
 
 int thread_get_priority (void);
 void thread_set_priority (int);
+void thread_donate_priority (struct thread *, int priority);
+void thread_refresh_priority (struct thread *);
 
 int thread_get_nice (void);
 void thread_set_nice (int);
@@ -174,4 +181,5 @@ void init_userprog(struct thread *t);
 void recalculate_load_avg(void);
 void recalculate_recent_cpu(void);
 void recalculate_priority(void);
+void thread_mlfqs_update(struct thread *t);
 #endif /* threads/thread.h */
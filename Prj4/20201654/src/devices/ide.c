@@ -50,6 +50,9 @@
 #define CMD_READ_SECTOR_RETRY 0x20      /* READ SECTOR with retries. */
 #define CMD_WRITE_SECTOR_RETRY 0x30     /* WRITE SECTOR with retries. */
 
+/* Most sectors a single READ/WRITE SECTOR command can transfer. */
+#define IDE_MAX_SECTORS 256
+
 /* An ATA device. */
 struct ata_disk
   {
@@ -86,6 +89,7 @@ static bool check_device_type (struct ata_disk *);
 static void identify_ata_device (struct ata_disk *);
 
 static void select_sector (struct ata_disk *, block_sector_t);
+static void select_sectors (struct ata_disk *, block_sector_t, size_t cnt);
 static void issue_pio_command (struct channel *, uint8_t command);
 static void input_sector (struct channel *, void *);
 static void output_sector (struct channel *, const void *);
@@ -376,10 +380,97 @@ ide_write (void *d_, block_sector_t sec_no, const void *buffer)
   lock_release (&c->lock);
 }
 
+/* Reads CNT consecutive sectors starting at SEC_NO from disk D
+   into BUFFER with a single READ SECTOR command.  The disk raises
+   one interrupt per sector. */
+static void
+ide_read_multiple (void *d_, block_sector_t sec_no, size_t cnt,
+                   void *buffer_)
+{
+  struct ata_disk *d = d_;
+  struct channel *c = d->channel;
+  uint8_t *buffer = buffer_;
+  size_t i;
+
+  ASSERT (cnt > 0 && cnt <= IDE_MAX_SECTORS);
+  lock_acquire (&c->lock);
+  select_sectors (d, sec_no, cnt);
+  issue_pio_command (c, CMD_READ_SECTOR_RETRY);
+  for (i = 0; i < cnt; i++)
+    {
+      sema_down (&c->completion_wait);
+      if (!wait_while_busy (d))
+        PANIC ("%s: disk read failed, sector=%"PRDSNu, d->name,
+               sec_no + i);
+      input_sector (c, buffer + i * BLOCK_SECTOR_SIZE);
+    }
+  lock_release (&c->lock);
+}
+
+/* Writes CNT consecutive sectors starting at SEC_NO to disk D
+   from BUFFER with a single WRITE SECTOR command.  Returns after
+   the disk has acknowledged receiving all of the data. */
+static void
+ide_write_multiple (void *d_, block_sector_t sec_no, size_t cnt,
+                    const void *buffer_)
+{
+  struct ata_disk *d = d_;
+  struct channel *c = d->channel;
+  const uint8_t *buffer = buffer_;
+  size_t i;
+
+  ASSERT (cnt > 0 && cnt <= IDE_MAX_SECTORS);
+  lock_acquire (&c->lock);
+  select_sectors (d, sec_no, cnt);
+  issue_pio_command (c, CMD_WRITE_SECTOR_RETRY);
+  for (i = 0; i < cnt; i++)
+    {
+      if (!wait_while_busy (d))
+        PANIC ("%s: disk write failed, sector=%"PRDSNu, d->name,
+               sec_no + i);
+      output_sector (c, buffer + i * BLOCK_SECTOR_SIZE);
+      sema_down (&c->completion_wait);
+    }
+  lock_release (&c->lock);
+}
+
+/* Transfers of more than IDE_MAX_SECTORS sectors are split into
+   several commands. */
+static void
+ide_read_split (void *d, block_sector_t sec_no, size_t cnt, void *buffer_)
+{
+  uint8_t *buffer = buffer_;
+  while (cnt > 0)
+    {
+      size_t chunk = cnt < IDE_MAX_SECTORS ? cnt : IDE_MAX_SECTORS;
+      ide_read_multiple (d, sec_no, chunk, buffer);
+      sec_no += chunk;
+      buffer += chunk * BLOCK_SECTOR_SIZE;
+      cnt -= chunk;
+    }
+}
+
+static void
+ide_write_split (void *d, block_sector_t sec_no, size_t cnt,
+                 const void *buffer_)
+{
+  const uint8_t *buffer = buffer_;
+  while (cnt > 0)
+    {
+      size_t chunk = cnt < IDE_MAX_SECTORS ? cnt : IDE_MAX_SECTORS;
+      ide_write_multiple (d, sec_no, chunk, buffer);
+      sec_no += chunk;
+      buffer += chunk * BLOCK_SECTOR_SIZE;
+      cnt -= chunk;
+    }
+}
+
 static struct block_operations ide_operations =
   {
     ide_read,
-    ide_write
+    ide_write,
+    ide_read_split,
+    ide_write_split
   };
 
 /* Selects device D, waiting for it to become ready, and then
@@ -387,13 +478,23 @@ static struct block_operations ide_operations =
    use LBA mode.) */
 static void
 select_sector (struct ata_disk *d, block_sector_t sec_no)
+{
+  select_sectors (d, sec_no, 1);
+}
+
+/* Like select_sector(), but selects CNT consecutive sectors
+   starting at SEC_NO.  A sector count of 0 means 256 to the
+   disk. */
+static void
+select_sectors (struct ata_disk *d, block_sector_t sec_no, size_t cnt)
 {
   struct channel *c = d->channel;
 
   ASSERT (sec_no < (1UL << 28));
+  ASSERT (cnt > 0 && cnt <= IDE_MAX_SECTORS);
   
   select_device_wait (d);
-  outb (reg_nsect (c), 1);
+  outb (reg_nsect (c), cnt == IDE_MAX_SECTORS ? 0 : cnt);
   outb (reg_lbal (c), sec_no);
   outb (reg_lbam (c), sec_no >> 8);
   outb (reg_lbah (c), (sec_no >> 16));
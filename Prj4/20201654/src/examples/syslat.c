@@ -0,0 +1,80 @@
+/* syslat.c
+
+   Measures the latency of the open, close, read and write system
+   calls.  Each call is made ITERATIONS times and the elapsed
+   timer ticks are printed, optionally for ITERATIONS given as
+   the first argument.
+
+   Usage: syslat [ITERATIONS] */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <syscall.h>
+
+#define FILE_NAME "syslat.tmp"
+
+static char buffer[512];
+
+int
+main (int argc, char *argv[]) 
+{
+  int iterations = argc > 1 ? atoi (argv[1]) : 1000;
+  int fd, i, start;
+
+  if (iterations <= 0)
+    {
+      printf ("usage: syslat [ITERATIONS]\n");
+      return EXIT_FAILURE;
+    }
+  if (!create (FILE_NAME, sizeof buffer))
+    {
+      printf ("%s: create failed\n", FILE_NAME);
+      return EXIT_FAILURE;
+    }
+
+  /* open + close. */
+  start = ticks ();
+  for (i = 0; i < iterations; i++)
+    {
+      fd = open (FILE_NAME);
+      if (fd < 0)
+        {
+          printf ("%s: open failed\n", FILE_NAME);
+          return EXIT_FAILURE;
+        }
+      close (fd);
+    }
+  printf ("open+close: %d ticks for %d calls\n", ticks () - start,
+          iterations);
+
+  fd = open (FILE_NAME);
+  if (fd < 0)
+    {
+      printf ("%s: open failed\n", FILE_NAME);
+      return EXIT_FAILURE;
+    }
+
+  /* read. */
+  start = ticks ();
+  for (i = 0; i < iterations; i++)
+    {
+      seek (fd, 0);
+      read (fd, buffer, sizeof buffer);
+    }
+  printf ("read: %d ticks for %d calls of %d bytes\n", ticks () - start,
+          iterations, (int) sizeof buffer);
+
+  /* write. */
+  start = ticks ();
+  for (i = 0; i < iterations; i++)
+    {
+      seek (fd, 0);
+      write (fd, buffer, sizeof buffer);
+    }
+  printf ("write: %d ticks for %d calls of %d bytes\n", ticks () - start,
+          iterations, (int) sizeof buffer);
+
+  close (fd);
+  remove (FILE_NAME);
+  return EXIT_SUCCESS;
+}
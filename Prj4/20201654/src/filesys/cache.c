@@ -0,0 +1,326 @@
+#include "filesys/cache.h"
+#include <debug.h>
+#include <stdio.h>
+#include <string.h>
+#include "devices/timer.h"
+#include "filesys/filesys.h"
+#include "filesys/free-map.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+#include "threads/thread.h"
+#include "threads/vaddr.h"
+
+/* Number of sectors in the buffer cache. */
+#define CACHE_SIZE 64
+
+/* Ticks between two passes of the flusher thread. */
+#define FLUSH_INTERVAL (5 * TIMER_FREQ)
+
+/* Maximum number of sectors waiting to be read ahead. */
+#define READAHEAD_QUEUE_SIZE 32
+
+/* A cached file system sector. */
+struct cache_entry
+  {
+    block_sector_t sector;              /* Sector held in DATA. */
+    bool in_use;                        /* True if DATA holds a sector. */
+    bool dirty;                         /* True if DATA is newer than disk. */
+    bool accessed;                      /* Used since the hand last passed. */
+    bool io;                            /* Disk transfer in progress. */
+    struct condition io_done;           /* Signaled when IO clears. */
+    uint8_t data[BLOCK_SECTOR_SIZE];    /* Sector contents. */
+  };
+
+/* The cache.  Replacement is a clock over the entries. */
+static struct cache_entry *cache;
+static size_t clock_hand;
+
+/* Protects every entry and the clock hand.  Released during disk
+   transfers; an entry being read or written back has IO set, and
+   other threads wait on its IO_DONE instead of using it. */
+static struct lock cache_lock;
+
+/* Statistics. */
+static long long cache_hit_cnt;         /* # of accesses served from memory. */
+static long long cache_miss_cnt;        /* # of accesses that read the disk. */
+static long long cache_writeback_cnt;   /* # of dirty sectors written. */
+static long long cache_readahead_cnt;   /* # of sectors read ahead. */
+
+/* Sectors to read ahead, a ring buffer of READAHEAD_CNT sectors
+   starting at READAHEAD_HEAD.  Requests that do not fit are
+   dropped. */
+static block_sector_t readahead_queue[READAHEAD_QUEUE_SIZE];
+static size_t readahead_head;
+static size_t readahead_cnt;
+static struct lock readahead_lock;      /* Protects the queue. */
+static struct condition readahead_ready; /* Signaled when it fills. */
+
+static thread_func flusher NO_RETURN;
+static thread_func reader NO_RETURN;
+
+/* Initializes the buffer cache and starts the flusher and
+   read-ahead threads. */
+void
+cache_init (void)
+{
+  size_t i;
+
+  cache = calloc (CACHE_SIZE, sizeof *cache);
+  if (cache == NULL)
+    PANIC ("cache_init: cannot allocate buffer cache");
+  for (i = 0; i < CACHE_SIZE; i++)
+    cond_init (&cache[i].io_done);
+  lock_init (&cache_lock);
+  clock_hand = 0;
+  lock_init (&readahead_lock);
+  cond_init (&readahead_ready);
+
+  thread_create ("flusher", PRI_DEFAULT, flusher, NULL);
+  thread_create ("readahead", PRI_DEFAULT, reader, NULL);
+}
+
+/* Writes entry E back to disk if it is dirty and not already
+   being transferred.  Releases cache_lock during the write.
+   Must be called with cache_lock held. */
+static void
+writeback (struct cache_entry *e)
+{
+  if (e->in_use && e->dirty && !e->io)
+    {
+      e->io = true;
+      lock_release (&cache_lock);
+      block_write (fs_device, e->sector, e->data);
+      lock_acquire (&cache_lock);
+      e->io = false;
+      e->dirty = false;
+      cache_writeback_cnt++;
+      cond_broadcast (&e->io_done, &cache_lock);
+    }
+}
+
+/* Frees an entry with the clock algorithm, writing back its
+   sector if needed, and returns it.  Entries with a transfer in
+   progress are skipped, or waited for if every entry has one.
+   Since cache_lock may be released meanwhile, the caller must
+   check again that its sector did not get cached.
+   Must be called with cache_lock held. */
+static struct cache_entry *
+evict (void)
+{
+  size_t skipped = 0;
+
+  for (;;)
+    {
+      struct cache_entry *e = &cache[clock_hand];
+      clock_hand = (clock_hand + 1) % CACHE_SIZE;
+
+      if (e->io)
+        {
+          if (++skipped >= CACHE_SIZE)
+            {
+              cond_wait (&e->io_done, &cache_lock);
+              skipped = 0;
+            }
+        }
+      else if (e->in_use && e->accessed)
+        e->accessed = false;
+      else if (e->in_use && e->dirty)
+        writeback (e);
+      else
+        {
+          e->in_use = false;
+          return e;
+        }
+    }
+}
+
+/* Returns the entry that holds SECTOR, or a null pointer if
+   SECTOR is not cached.  The entry may still be loading.
+   Must be called with cache_lock held. */
+static struct cache_entry *
+find (block_sector_t sector)
+{
+  size_t i;
+
+  for (i = 0; i < CACHE_SIZE; i++)
+    if (cache[i].in_use && cache[i].sector == sector)
+      return &cache[i];
+  return NULL;
+}
+
+/* Loads SECTOR into the free entry E, reading it from disk with
+   cache_lock released unless FILL is false.
+   Must be called with cache_lock held. */
+static void
+load (struct cache_entry *e, block_sector_t sector, bool fill)
+{
+  e->sector = sector;
+  e->in_use = true;
+  e->dirty = false;
+  e->accessed = true;
+  if (fill)
+    {
+      e->io = true;
+      lock_release (&cache_lock);
+      block_read (fs_device, sector, e->data);
+      lock_acquire (&cache_lock);
+      e->io = false;
+      cond_broadcast (&e->io_done, &cache_lock);
+    }
+}
+
+/* Returns the entry that holds SECTOR.  On a miss, the sector is
+   read from disk unless FILL is false, i.e. the caller is about to
+   overwrite all of it.  Waits for a transfer of the entry already
+   in progress to finish.
+   Must be called with cache_lock held. */
+static struct cache_entry *
+lookup (block_sector_t sector, bool fill)
+{
+  for (;;)
+    {
+      struct cache_entry *e = find (sector);
+
+      if (e == NULL)
+        {
+          e = evict ();
+          /* Someone may have cached SECTOR while evict() wrote
+             back a sector. */
+          if (find (sector) != NULL)
+            continue;
+          cache_miss_cnt++;
+          load (e, sector, fill);
+          return e;
+        }
+      if (!e->io)
+        {
+          cache_hit_cnt++;
+          e->accessed = true;
+          return e;
+        }
+      cond_wait (&e->io_done, &cache_lock);
+    }
+}
+
+/* Reads SIZE bytes at offset OFS of SECTOR into BUFFER.
+
+   A user BUFFER may page fault, and the fault may read a file
+   through the cache, so user memory is only touched without
+   cache_lock held. */
+void
+cache_read (block_sector_t sector, void *buffer, size_t ofs, size_t size)
+{
+  uint8_t bounce[BLOCK_SECTOR_SIZE];
+  bool user = is_user_vaddr (buffer);
+
+  ASSERT (ofs + size <= BLOCK_SECTOR_SIZE);
+
+  lock_acquire (&cache_lock);
+  memcpy (user ? bounce : buffer, lookup (sector, true)->data + ofs, size);
+  lock_release (&cache_lock);
+  if (user)
+    memcpy (buffer, bounce, size);
+}
+
+/* Writes SIZE bytes from BUFFER at offset OFS of SECTOR.  The
+   sector reaches the disk when it is evicted or flushed. */
+void
+cache_write (block_sector_t sector, const void *buffer, size_t ofs,
+             size_t size)
+{
+  uint8_t bounce[BLOCK_SECTOR_SIZE];
+
+  ASSERT (ofs + size <= BLOCK_SECTOR_SIZE);
+
+  /* See cache_read(). */
+  if (is_user_vaddr (buffer))
+    buffer = memcpy (bounce, buffer, size);
+
+  lock_acquire (&cache_lock);
+  struct cache_entry *e = lookup (sector, size < BLOCK_SECTOR_SIZE);
+  memcpy (e->data + ofs, buffer, size);
+  e->dirty = true;
+  lock_release (&cache_lock);
+}
+
+/* Asks the read-ahead thread to bring SECTOR into the cache.
+   Returns without waiting for it. */
+void
+cache_readahead (block_sector_t sector)
+{
+  lock_acquire (&readahead_lock);
+  if (readahead_cnt < READAHEAD_QUEUE_SIZE)
+    {
+      readahead_queue[(readahead_head + readahead_cnt++)
+                      % READAHEAD_QUEUE_SIZE] = sector;
+      cond_signal (&readahead_ready, &readahead_lock);
+    }
+  lock_release (&readahead_lock);
+}
+
+/* Writes every dirty sector to disk. */
+void
+cache_flush (void)
+{
+  size_t i;
+
+  lock_acquire (&cache_lock);
+  for (i = 0; i < CACHE_SIZE; i++)
+    writeback (&cache[i]);
+  lock_release (&cache_lock);
+}
+
+/* Prints buffer cache statistics. */
+void
+cache_print_stats (void)
+{
+  printf ("Cache: %lld hits, %lld misses, %lld sectors written back, "
+          "%lld read ahead\n",
+          cache_hit_cnt, cache_miss_cnt, cache_writeback_cnt,
+          cache_readahead_cnt);
+}
+
+/* Flusher thread.  Bounds the amount of data lost in a crash by
+   writing dirty sectors back every FLUSH_INTERVAL ticks. */
+static void
+flusher (void *aux UNUSED)
+{
+  for (;;)
+    {
+      timer_sleep (FLUSH_INTERVAL);
+      /* The free map is written through the cache as well. */
+      free_map_flush ();
+      cache_flush ();
+    }
+}
+
+/* Read-ahead thread.  Reads the sectors queued by
+   cache_readahead() that are not cached yet. */
+static void
+reader (void *aux UNUSED)
+{
+  for (;;)
+    {
+      block_sector_t sector;
+
+      lock_acquire (&readahead_lock);
+      while (readahead_cnt == 0)
+        cond_wait (&readahead_ready, &readahead_lock);
+      sector = readahead_queue[readahead_head];
+      readahead_head = (readahead_head + 1) % READAHEAD_QUEUE_SIZE;
+      readahead_cnt--;
+      lock_release (&readahead_lock);
+
+      lock_acquire (&cache_lock);
+      if (find (sector) == NULL)
+        {
+          struct cache_entry *e = evict ();
+          if (find (sector) == NULL)
+            {
+              load (e, sector, true);
+              cache_readahead_cnt++;
+            }
+        }
+      lock_release (&cache_lock);
+    }
+}
@@ -0,0 +1,175 @@
+#include "filesys/dcache.h"
+#include <debug.h>
+#include <hash.h>
+#include <list.h>
+#include <stdio.h>
+#include <string.h>
+#include "filesys/directory.h"
+#include "threads/malloc.h"
+#include "threads/synch.h"
+
+/* Maximum number of cached names. */
+#define DCACHE_SIZE 128
+
+/* A cached name in a directory. */
+struct dentry
+  {
+    struct hash_elem elem;              /* Element in dentries. */
+    struct list_elem lru_elem;          /* Element in lru_list. */
+    block_sector_t dir;                 /* Directory's inode sector. */
+    char name[NAME_MAX + 1];            /* Null terminated file name. */
+    block_sector_t sector;              /* File's inode sector or
+                                           DCACHE_NO_FILE. */
+  };
+
+/* Cached names, keyed by directory and name. */
+static struct hash dentries;
+
+/* Cached names, most recently used first. */
+static struct list lru_list;
+
+/* Protects dentries and lru_list. */
+static struct lock dcache_lock;
+
+/* Statistics. */
+static long long dcache_hit_cnt;        /* # of lookups of an existing file. */
+static long long dcache_neg_hit_cnt;    /* # of lookups of a missing file. */
+static long long dcache_miss_cnt;       /* # of lookups not cached. */
+
+static unsigned
+dentry_hash (const struct hash_elem *e_, void *aux UNUSED)
+{
+  const struct dentry *e = hash_entry (e_, struct dentry, elem);
+  return hash_string (e->name) ^ hash_int (e->dir);
+}
+
+static bool
+dentry_less (const struct hash_elem *a_, const struct hash_elem *b_,
+             void *aux UNUSED)
+{
+  const struct dentry *a = hash_entry (a_, struct dentry, elem);
+  const struct dentry *b = hash_entry (b_, struct dentry, elem);
+  if (a->dir != b->dir)
+    return a->dir < b->dir;
+  return strcmp (a->name, b->name) < 0;
+}
+
+/* Initializes the dentry cache. */
+void
+dcache_init (void)
+{
+  hash_init (&dentries, dentry_hash, dentry_less, NULL);
+  list_init (&lru_list);
+  lock_init (&dcache_lock);
+}
+
+/* Returns the cached dentry for NAME in DIR, or a null pointer.
+   Must be called with dcache_lock held. */
+static struct dentry *
+find (block_sector_t dir, const char *name)
+{
+  struct dentry key;
+  struct hash_elem *e;
+
+  key.dir = dir;
+  strlcpy (key.name, name, sizeof key.name);
+  e = hash_find (&dentries, &key.elem);
+  return e != NULL ? hash_entry (e, struct dentry, elem) : NULL;
+}
+
+/* Looks up NAME in the directory whose inode is in sector DIR.
+   If the cache knows NAME, returns true and stores in *SECTORP
+   its inode sector, or DCACHE_NO_FILE if it does not exist.
+   Otherwise, returns false. */
+bool
+dcache_lookup (block_sector_t dir, const char *name, block_sector_t *sectorp)
+{
+  struct dentry *d;
+
+  if (strlen (name) > NAME_MAX)
+    return false;
+
+  lock_acquire (&dcache_lock);
+  d = find (dir, name);
+  if (d != NULL)
+    {
+      *sectorp = d->sector;
+      list_remove (&d->lru_elem);
+      list_push_front (&lru_list, &d->lru_elem);
+      if (d->sector != DCACHE_NO_FILE)
+        dcache_hit_cnt++;
+      else
+        dcache_neg_hit_cnt++;
+    }
+  else
+    dcache_miss_cnt++;
+  lock_release (&dcache_lock);
+  return d != NULL;
+}
+
+/* Records that NAME in directory DIR has its inode in SECTOR, or
+   does not exist if SECTOR is DCACHE_NO_FILE.  Evicts the least
+   recently used name if the cache is full. */
+void
+dcache_insert (block_sector_t dir, const char *name, block_sector_t sector)
+{
+  struct dentry *d;
+
+  if (strlen (name) > NAME_MAX)
+    return;
+
+  lock_acquire (&dcache_lock);
+  d = find (dir, name);
+  if (d == NULL)
+    {
+      if (hash_size (&dentries) >= DCACHE_SIZE)
+        {
+          d = list_entry (list_pop_back (&lru_list), struct dentry, lru_elem);
+          hash_delete (&dentries, &d->elem);
+        }
+      else
+        d = malloc (sizeof *d);
+      if (d == NULL)
+        {
+          lock_release (&dcache_lock);
+          return;
+        }
+      d->dir = dir;
+      strlcpy (d->name, name, sizeof d->name);
+      hash_insert (&dentries, &d->elem);
+    }
+  else
+    list_remove (&d->lru_elem);
+  d->sector = sector;
+  list_push_front (&lru_list, &d->lru_elem);
+  lock_release (&dcache_lock);
+}
+
+/* Forgets NAME in directory DIR.  Called whenever an entry for
+   NAME is added to or removed from DIR. */
+void
+dcache_invalidate (block_sector_t dir, const char *name)
+{
+  struct dentry *d;
+
+  if (strlen (name) > NAME_MAX)
+    return;
+
+  lock_acquire (&dcache_lock);
+  d = find (dir, name);
+  if (d != NULL)
+    {
+      hash_delete (&dentries, &d->elem);
+      list_remove (&d->lru_elem);
+      free (d);
+    }
+  lock_release (&dcache_lock);
+}
+
+/* Prints dentry cache statistics. */
+void
+dcache_print_stats (void)
+{
+  printf ("Dentry cache: %lld hits, %lld negative hits, %lld misses\n",
+          dcache_hit_cnt, dcache_neg_hit_cnt, dcache_miss_cnt);
+}
@@ -1,7 +1,9 @@
 #include "filesys/directory.h"
 #include <stdio.h>
 #include <string.h>
+#include <hash.h>
 #include <list.h>
+#include "filesys/dcache.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
 #include "threads/malloc.h"
@@ -21,12 +23,245 @@ struct dir_entry
     bool in_use;                        /* In use or free? */
   };
 
-/* Creates a directory with space for ENTRY_CNT entries in the
-   given SECTOR.  Returns true if successful, false on failure. */
+/* Identifies a hashed directory. */
+#define DIR_MAGIC 0x48524944
+
+/* Minimum number of buckets in a hashed directory. */
+#define MIN_BUCKETS 16
+
+/* A hashed directory starts with this header, which occupies the
+   first entry slot.  The rest of the directory is an open
+   addressed table of BUCKET_CNT entries, probed linearly from
+   hash_string() of the name.  An entry that is not in use and
+   has an empty name ends a probe; one that is not in use but
+   still has a name is a removed entry and does not.
+
+   A directory without the magic number is in the original
+   linear format: its entries are searched one by one, and it is
+   converted to the hashed format the first time a file is added
+   to it. */
+struct dir_header
+  {
+    uint32_t magic;                     /* DIR_MAGIC. */
+    uint32_t bucket_cnt;                /* Number of buckets, a power of 2. */
+    uint32_t entry_cnt;                 /* Number of entries in use. */
+    uint32_t slot_cnt;                  /* Entries in use or removed. */
+    uint8_t unused[4];                  /* Pads to an entry's size. */
+  };
+
+/* Reads the header of DIR into *H.  Returns true if DIR is a
+   hashed directory, false if it is a linear one. */
+static bool
+read_header (const struct dir *dir, struct dir_header *h)
+{
+  return (inode_read_at (dir->inode, h, sizeof *h, 0) == sizeof *h
+          && h->magic == DIR_MAGIC);
+}
+
+/* Writes header H to DIR. */
+static bool
+write_header (struct dir *dir, const struct dir_header *h)
+{
+  return inode_write_at (dir->inode, h, sizeof *h, 0) == sizeof *h;
+}
+
+/* Returns the byte offset of bucket IDX. */
+static off_t
+bucket_ofs (size_t idx)
+{
+  return (idx + 1) * sizeof (struct dir_entry);
+}
+
+/* Returns the smallest power of 2 that is at least CNT and at
+   least MIN_BUCKETS. */
+static size_t
+round_buckets (size_t cnt)
+{
+  size_t n = MIN_BUCKETS;
+  while (n < cnt)
+    n *= 2;
+  return n;
+}
+
+/* Searches the hashed directory DIR, whose header is H, for NAME.
+   Returns the offset of its entry, storing the entry in *EP, or
+   -1 if there is none.  If FREEP is non-null, stores in it the
+   offset of the first free or removed slot on NAME's probe
+   sequence, or -1 if the table is full. */
+static off_t
+hash_lookup (const struct dir *dir, const struct dir_header *h,
+             const char *name, struct dir_entry *ep, off_t *freep)
+{
+  size_t mask = h->bucket_cnt - 1;
+  size_t idx = hash_string (name) & mask;
+  size_t i;
+
+  if (freep != NULL)
+    *freep = -1;
+  for (i = 0; i < h->bucket_cnt; i++, idx = (idx + 1) & mask)
+    {
+      off_t ofs = bucket_ofs (idx);
+
+      if (inode_read_at (dir->inode, ep, sizeof *ep, ofs) != sizeof *ep)
+        break;
+      if (ep->in_use)
+        {
+          if (!strcmp (name, ep->name))
+            return ofs;
+        }
+      else
+        {
+          if (freep != NULL && *freep == -1)
+            *freep = ofs;
+          if (ep->name[0] == '\0')
+            break;
+        }
+    }
+  return -1;
+}
+
+/* Rewrites DIR as a hashed directory of BUCKET_CNT buckets that
+   holds the ENTRY_CNT entries in ENTRIES.  BUCKET_CNT must be
+   large enough that the table covers all of DIR's old contents. */
+static bool
+rebuild (struct dir *dir, size_t bucket_cnt,
+         const struct dir_entry *entries, size_t entry_cnt)
+{
+  struct dir_header h;
+  struct dir_entry e;
+  void *zeros;
+  off_t ofs, end;
+  size_t i;
+
+  zeros = calloc (1, BLOCK_SECTOR_SIZE);
+  if (zeros == NULL)
+    return false;
+  end = bucket_ofs (bucket_cnt);
+  for (ofs = 0; ofs < end; ofs += BLOCK_SECTOR_SIZE)
+    {
+      off_t chunk = end - ofs;
+      if (chunk > BLOCK_SECTOR_SIZE)
+        chunk = BLOCK_SECTOR_SIZE;
+      if (inode_write_at (dir->inode, zeros, chunk, ofs) != chunk)
+        {
+          free (zeros);
+          return false;
+        }
+    }
+  free (zeros);
+
+  memset (&h, 0, sizeof h);
+  h.magic = DIR_MAGIC;
+  h.bucket_cnt = bucket_cnt;
+  for (i = 0; i < entry_cnt; i++)
+    {
+      off_t free_ofs;
+      hash_lookup (dir, &h, entries[i].name, &e, &free_ofs);
+      if (free_ofs == -1
+          || inode_write_at (dir->inode, &entries[i], sizeof e, free_ofs)
+             != sizeof e)
+        return false;
+    }
+  h.entry_cnt = h.slot_cnt = entry_cnt;
+  return write_header (dir, &h);
+}
+
+/* Collects the entries in use in DIR, which has room for at most
+   SLOT_CNT entries starting at offset START, into a new array
+   whose size is stored in *CNTP.  Returns the array, which the
+   caller must free, or a null pointer if memory is short. */
+static struct dir_entry *
+collect_entries (const struct dir *dir, off_t start, size_t slot_cnt,
+                 size_t *cntp)
+{
+  struct dir_entry *entries;
+  struct dir_entry e;
+  size_t i;
+  off_t ofs;
+
+  entries = malloc ((slot_cnt + 1) * sizeof *entries);
+  if (entries == NULL)
+    return NULL;
+  *cntp = 0;
+  for (i = 0, ofs = start;
+       i < slot_cnt
+         && inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
+       i++, ofs += sizeof e)
+    if (e.in_use)
+      entries[(*cntp)++] = e;
+  return entries;
+}
+
+/* Converts DIR from the linear format to the hashed format. */
+static bool
+upgrade (struct dir *dir)
+{
+  size_t slot_cnt = inode_length (dir->inode) / sizeof (struct dir_entry);
+  struct dir_entry *entries;
+  size_t cnt;
+  bool success;
+
+  entries = collect_entries (dir, 0, slot_cnt, &cnt);
+  if (entries == NULL)
+    return false;
+  /* The table must cover every old slot, or readdir would still
+     see them. */
+  success = rebuild (dir, round_buckets (slot_cnt > cnt * 2
+                                         ? slot_cnt : cnt * 2),
+                     entries, cnt);
+  free (entries);
+  return success;
+}
+
+/* Makes room for one more entry in the hashed directory DIR,
+   whose header is *H, by rehashing it if its table is more than
+   3/4 full of entries in use or removed.  Rereads *H if so. */
+static bool
+make_room (struct dir *dir, struct dir_header *h)
+{
+  struct dir_entry *entries;
+  size_t cnt;
+  bool success;
+
+  if ((h->slot_cnt + 1) * 4 <= h->bucket_cnt * 3)
+    return true;
+
+  entries = collect_entries (dir, bucket_ofs (0), h->bucket_cnt, &cnt);
+  if (entries == NULL)
+    return false;
+  /* Only grow if the entries in use, not removed ones, need it. */
+  success = rebuild (dir, (cnt + 1) * 2 > h->bucket_cnt
+                          ? h->bucket_cnt * 2 : h->bucket_cnt,
+                     entries, cnt);
+  free (entries);
+  return success && read_header (dir, h);
+}
+
+/* Creates a hashed directory with space for ENTRY_CNT entries in
+   the given SECTOR.  Returns true if successful, false on
+   failure. */
 bool
 dir_create (block_sector_t sector, size_t entry_cnt)
 {
-  return inode_create (sector, entry_cnt * sizeof (struct dir_entry));
+  size_t bucket_cnt = round_buckets (entry_cnt * 4 / 3 + 1);
+  struct dir_header h;
+  struct inode *inode;
+  bool success;
+
+  ASSERT (sizeof h == sizeof (struct dir_entry));
+
+  if (!inode_create (sector, bucket_ofs (bucket_cnt)))
+    return false;
+  inode = inode_open (sector);
+  if (inode == NULL)
+    return false;
+
+  memset (&h, 0, sizeof h);
+  h.magic = DIR_MAGIC;
+  h.bucket_cnt = bucket_cnt;
+  success = inode_write_at (inode, &h, sizeof h, 0) == sizeof h;
+  inode_close (inode);
+  return success;
 }
 
 /* Opens and returns the directory for the given INODE, of which
@@ -92,12 +327,26 @@ static bool
 lookup (const struct dir *dir, const char *name,
         struct dir_entry *ep, off_t *ofsp) 
 {
+  struct dir_header h;
   struct dir_entry e;
   size_t ofs;
   
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
+  if (read_header (dir, &h))
+    {
+      off_t hofs = hash_lookup (dir, &h, name, &e, NULL);
+      if (hofs == -1)
+        return false;
+      if (ep != NULL)
+        *ep = e;
+      if (ofsp != NULL)
+        *ofsp = hofs;
+      return true;
+    }
+
+  /* Linear directory. */
   for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
        ofs += sizeof e) 
     if (e.in_use && !strcmp (name, e.name)) 
@@ -114,24 +363,75 @@ lookup (const struct dir *dir, const char *name,
 /* Searches DIR for a file with the given NAME
    and returns true if one exists, false otherwise.
    On success, sets *INODE to an inode for the file, otherwise to
-   a null pointer.  The caller must close *INODE. */
+   a null pointer.  The caller must close *INODE.
+   Consults the dentry cache first, so repeated lookups of the same
+   name, found or not, do not search DIR. */
 bool
 dir_lookup (const struct dir *dir, const char *name,
             struct inode **inode) 
 {
+  block_sector_t dir_sector, sector;
   struct dir_entry e;
 
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
-  if (lookup (dir, name, &e, NULL))
-    *inode = inode_open (e.inode_sector);
+  /* Open the inode before releasing DIR's lock, so that a
+     concurrent dir_remove() cannot free its sector in between. */
+  dir_sector = inode_get_inumber (dir->inode);
+  inode_lock (dir->inode);
+  if (!dcache_lookup (dir_sector, name, &sector))
+    {
+      sector = lookup (dir, name, &e, NULL) ? e.inode_sector : DCACHE_NO_FILE;
+      dcache_insert (dir_sector, name, sector);
+    }
+
+  if (sector != DCACHE_NO_FILE)
+    *inode = inode_open (sector);
   else
     *inode = NULL;
+  inode_unlock (dir->inode);
 
   return *inode != NULL;
 }
 
+/* Adds NAME to DIR for dir_add().
+   Must be called with DIR's lock held. */
+static bool
+add_entry (struct dir *dir, const char *name, block_sector_t inode_sector)
+{
+  struct dir_header h;
+  struct dir_entry e;
+  off_t ofs;
+  bool reused;
+
+  /* Convert a linear directory, then make room for the entry. */
+  if (!read_header (dir, &h) && (!upgrade (dir) || !read_header (dir, &h)))
+    return false;
+  if (!make_room (dir, &h))
+    return false;
+
+  /* Check that NAME is not in use and find a slot for it. */
+  if (hash_lookup (dir, &h, name, &e, &ofs) != -1 || ofs == -1)
+    return false;
+  if (inode_read_at (dir->inode, &e, sizeof e, ofs) != sizeof e)
+    return false;
+  reused = e.name[0] != '\0';
+
+  /* Write slot. */
+  e.in_use = true;
+  strlcpy (e.name, name, sizeof e.name);
+  e.inode_sector = inode_sector;
+  if (inode_write_at (dir->inode, &e, sizeof e, ofs) != sizeof e)
+    return false;
+  dcache_invalidate (inode_get_inumber (dir->inode), name);
+
+  h.entry_cnt++;
+  if (!reused)
+    h.slot_cnt++;
+  return write_header (dir, &h);
+}
+
 /* Adds a file named NAME to DIR, which must not already contain a
    file by that name.  The file's inode is in sector
    INODE_SECTOR.
@@ -141,9 +441,7 @@ dir_lookup (const struct dir *dir, const char *name,
 bool
 dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
 {
-  struct dir_entry e;
-  off_t ofs;
-  bool success = false;
+  bool success;
 
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
@@ -152,29 +450,9 @@ dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
   if (*name == '\0' || strlen (name) > NAME_MAX)
     return false;
 
-  /* Check that NAME is not in use. */
-  if (lookup (dir, name, NULL, NULL))
-    goto done;
-
-  /* Set OFS to offset of free slot.
-     If there are no free slots, then it will be set to the
-     current end-of-file.
-     
-     inode_read_at() will only return a short read at end of file.
-     Otherwise, we'd need to verify that we didn't get a short
-     read due to something intermittent such as low memory. */
-  for (ofs = 0; inode_read_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
-       ofs += sizeof e) 
-    if (!e.in_use)
-      break;
-
-  /* Write slot. */
-  e.in_use = true;
-  strlcpy (e.name, name, sizeof e.name);
-  e.inode_sector = inode_sector;
-  success = inode_write_at (dir->inode, &e, sizeof e, ofs) == sizeof e;
-
- done:
+  inode_lock (dir->inode);
+  success = add_entry (dir, name, inode_sector);
+  inode_unlock (dir->inode);
   return success;
 }
 
@@ -184,6 +462,7 @@ dir_add (struct dir *dir, const char *name, block_sector_t inode_sector)
 bool
 dir_remove (struct dir *dir, const char *name) 
 {
+  struct dir_header h;
   struct dir_entry e;
   struct inode *inode = NULL;
   bool success = false;
@@ -192,6 +471,8 @@ dir_remove (struct dir *dir, const char *name)
   ASSERT (dir != NULL);
   ASSERT (name != NULL);
 
+  inode_lock (dir->inode);
+
   /* Find directory entry. */
   if (!lookup (dir, name, &e, &ofs))
     goto done;
@@ -201,36 +482,49 @@ dir_remove (struct dir *dir, const char *name)
   if (inode == NULL)
     goto done;
 
-  /* Erase directory entry. */
+  /* Erase directory entry.  Its name stays, so that a hashed
+     lookup keeps probing past it. */
   e.in_use = false;
   if (inode_write_at (dir->inode, &e, sizeof e, ofs) != sizeof e) 
     goto done;
+  dcache_invalidate (inode_get_inumber (dir->inode), name);
+  if (read_header (dir, &h))
+    {
+      h.entry_cnt--;
+      write_header (dir, &h);
+    }
 
   /* Remove inode. */
   inode_remove (inode);
   success = true;
 
  done:
+  inode_unlock (dir->inode);
   inode_close (inode);
   return success;
 }
 
 /* Reads the next directory entry in DIR and stores the name in
    NAME.  Returns true if successful, false if the directory
-   contains no more entries. */
+   contains no more entries.  The header of a hashed directory is
+   never in use, so it is skipped like a free entry. */
 bool
 dir_readdir (struct dir *dir, char name[NAME_MAX + 1])
 {
   struct dir_entry e;
+  bool found = false;
 
+  inode_lock (dir->inode);
   while (inode_read_at (dir->inode, &e, sizeof e, dir->pos) == sizeof e) 
     {
       dir->pos += sizeof e;
       if (e.in_use)
         {
           strlcpy (name, e.name, NAME_MAX + 1);
-          return true;
+          found = true;
+          break;
         } 
     }
-  return false;
+  inode_unlock (dir->inode);
+  return found;
 }
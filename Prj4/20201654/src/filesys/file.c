@@ -3,14 +3,49 @@
 #include "filesys/inode.h"
 #include "threads/malloc.h"
 
+/* Read-ahead window bounds, in sectors.  The window starts at
+   READAHEAD_MIN on the first sequential read and doubles on every
+   following one, up to READAHEAD_MAX. */
+#define READAHEAD_MIN 2
+#define READAHEAD_MAX 16
+
 /* An open file. */
 struct file 
   {
     struct inode *inode;        /* File's inode. */
     off_t pos;                  /* Current position. */
     bool deny_write;            /* Has file_deny_write() been called? */
+    off_t ra_next;              /* Where a sequential read would start. */
+    off_t ra_end;               /* End of the range read ahead so far. */
+    size_t ra_window;           /* Read-ahead window, in sectors. */
   };
 
+/* Grows FILE's read-ahead window and asynchronously reads the
+   part of the window past FILE's position that has not been read
+   ahead yet. */
+static void
+readahead (struct file *file)
+{
+  off_t end;
+
+  if (file->ra_window == 0)
+    {
+      file->ra_window = READAHEAD_MIN;
+      file->ra_end = file->pos;
+    }
+  else if (file->ra_window < READAHEAD_MAX)
+    file->ra_window *= 2;
+
+  if (file->ra_end < file->pos)
+    file->ra_end = file->pos;
+  end = file->pos + file->ra_window * BLOCK_SECTOR_SIZE;
+  if (end > file->ra_end)
+    {
+      inode_readahead (file->inode, end - file->ra_end, file->ra_end);
+      file->ra_end = end;
+    }
+}
+
 /* Opens a file for the given INODE, of which it takes ownership,
    and returns the new file.  Returns a null pointer if an
    allocation fails or if INODE is null. */
@@ -23,6 +58,8 @@ file_open (struct inode *inode)
       file->inode = inode;
       file->pos = 0;
       file->deny_write = false;
+      file->ra_next = file->ra_end = 0;
+      file->ra_window = 0;
       return file;
     }
   else
@@ -64,12 +101,20 @@ file_get_inode (struct file *file)
    starting at the file's current position.
    Returns the number of bytes actually read,
    which may be less than SIZE if end of file is reached.
-   Advances FILE's position by the number of bytes read. */
+   Advances FILE's position by the number of bytes read.
+   If the read continues the previous one, starts reading the
+   data after it ahead; see readahead(). */
 off_t
 file_read (struct file *file, void *buffer, off_t size) 
 {
+  bool sequential = file->pos == file->ra_next;
   off_t bytes_read = inode_read_at (file->inode, buffer, size, file->pos);
   file->pos += bytes_read;
+  if (sequential && bytes_read > 0)
+    readahead (file);
+  else
+    file->ra_window = 0;
+  file->ra_next = file->pos;
   return bytes_read;
 }
 
@@ -1,13 +1,44 @@
 #include "filesys/free-map.h"
 #include <bitmap.h>
 #include <debug.h>
+#include <round.h>
+#include <stdio.h>
 #include "filesys/file.h"
 #include "filesys/filesys.h"
 #include "filesys/inode.h"
+#include "threads/synch.h"
 
 static struct file *free_map_file;   /* Free map file. */
 static struct bitmap *free_map;      /* Free map, one bit per sector. */
 
+/* Protects free_map, dirty_sectors and the statistics.  Held
+   while free_map_flush() writes the free map file, which never
+   grows and so never allocates sectors itself. */
+static struct lock free_map_lock;
+
+/* Sectors of the free map file that differ from the disk, one bit
+   per sector.  Allocations only mark them; free_map_flush() writes
+   them. */
+static struct bitmap *dirty_sectors;
+
+/* Statistics. */
+static long long free_map_alloc_cnt;   /* # of allocations. */
+static long long free_map_release_cnt; /* # of releases. */
+static long long free_map_write_cnt;   /* # of free map sectors written. */
+
+/* Marks the free map file sectors that hold the bits of CNT
+   sectors starting at SECTOR as dirty. */
+static void
+mark_dirty (block_sector_t sector, size_t cnt)
+{
+  size_t bits_per_sector = BLOCK_SECTOR_SIZE * 8;
+  size_t first = sector / bits_per_sector;
+  size_t last = (sector + cnt - 1) / bits_per_sector;
+
+  if (cnt > 0)
+    bitmap_set_multiple (dirty_sectors, first, last - first + 1, true);
+}
+
 /* Initializes the free map. */
 void
 free_map_init (void) 
@@ -17,36 +48,106 @@ free_map_init (void)
     PANIC ("bitmap creation failed--file system device is too large");
   bitmap_mark (free_map, FREE_MAP_SECTOR);
   bitmap_mark (free_map, ROOT_DIR_SECTOR);
+
+  lock_init (&free_map_lock);
+  dirty_sectors = bitmap_create (DIV_ROUND_UP (bitmap_file_size (free_map),
+                                               BLOCK_SECTOR_SIZE));
+  if (dirty_sectors == NULL)
+    PANIC ("bitmap creation failed--file system device is too large");
 }
 
 /* Allocates CNT consecutive sectors from the free map and stores
    the first into *SECTORP.
    Returns true if successful, false if not enough consecutive
-   sectors were available or if the free_map file could not be
-   written. */
+   sectors were available. */
 bool
 free_map_allocate (size_t cnt, block_sector_t *sectorp)
 {
-  block_sector_t sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
-  if (sector != BITMAP_ERROR
-      && free_map_file != NULL
-      && !bitmap_write (free_map, free_map_file))
+  block_sector_t sector;
+
+  lock_acquire (&free_map_lock);
+  sector = bitmap_scan_and_flip (free_map, 0, cnt, false);
+  if (sector != BITMAP_ERROR)
     {
-      bitmap_set_multiple (free_map, sector, cnt, false); 
-      sector = BITMAP_ERROR;
+      mark_dirty (sector, cnt);
+      free_map_alloc_cnt++;
+      *sectorp = sector;
     }
-  if (sector != BITMAP_ERROR)
-    *sectorp = sector;
+  lock_release (&free_map_lock);
   return sector != BITMAP_ERROR;
 }
 
+/* Allocates up to CNT sectors starting exactly at SECTOR, stopping
+   at the first sector that is in use, and returns the number
+   allocated.  Used to grow a run of sectors in place. */
+size_t
+free_map_extend (block_sector_t sector, size_t cnt)
+{
+  size_t n = 0;
+
+  lock_acquire (&free_map_lock);
+  while (n < cnt && sector + n < bitmap_size (free_map)
+         && !bitmap_test (free_map, sector + n))
+    n++;
+  if (n > 0)
+    {
+      bitmap_set_multiple (free_map, sector, n, true);
+      mark_dirty (sector, n);
+      free_map_alloc_cnt++;
+    }
+  lock_release (&free_map_lock);
+  return n;
+}
+
 /* Makes CNT sectors starting at SECTOR available for use. */
 void
 free_map_release (block_sector_t sector, size_t cnt)
 {
+  lock_acquire (&free_map_lock);
   ASSERT (bitmap_all (free_map, sector, cnt));
   bitmap_set_multiple (free_map, sector, cnt, false);
-  bitmap_write (free_map, free_map_file);
+  mark_dirty (sector, cnt);
+  free_map_release_cnt++;
+  lock_release (&free_map_lock);
+}
+
+/* Writes the dirty sectors of the free map to its file.  Must be
+   called with free_map_lock held. */
+static void
+write_dirty (void)
+{
+  size_t i;
+
+  for (i = 0; i < bitmap_size (dirty_sectors); i++)
+    if (bitmap_test (dirty_sectors, i))
+      {
+        if (!bitmap_write_part (free_map, free_map_file,
+                                i * BLOCK_SECTOR_SIZE, BLOCK_SECTOR_SIZE))
+          PANIC ("can't write free map");
+        bitmap_reset (dirty_sectors, i);
+        free_map_write_cnt++;
+      }
+}
+
+/* Writes the dirty sectors of the free map to its file, if it is
+   open.  Called at shutdown and periodically by the buffer cache
+   flusher. */
+void
+free_map_flush (void)
+{
+  lock_acquire (&free_map_lock);
+  if (free_map_file != NULL)
+    write_dirty ();
+  lock_release (&free_map_lock);
+}
+
+/* Prints free map statistics. */
+void
+free_map_print_stats (void)
+{
+  printf ("Free map: %lld allocations, %lld releases, "
+          "%lld sectors written\n",
+          free_map_alloc_cnt, free_map_release_cnt, free_map_write_cnt);
 }
 
 /* Opens the free map file and reads it from disk. */
@@ -64,7 +165,16 @@ free_map_open (void)
 void
 free_map_close (void) 
 {
-  file_close (free_map_file);
+  struct file *file;
+
+  /* The flusher must not see the file between the last write and
+     the close. */
+  lock_acquire (&free_map_lock);
+  write_dirty ();
+  file = free_map_file;
+  free_map_file = NULL;
+  lock_release (&free_map_lock);
+  file_close (file);
 }
 
 /* Creates a new free map file on disk and writes the free map to
@@ -82,4 +192,5 @@ free_map_create (void)
     PANIC ("can't open free map");
   if (!bitmap_write (free_map, free_map_file))
     PANIC ("can't write free map");
+  bitmap_set_all (dirty_sectors, false);
 }
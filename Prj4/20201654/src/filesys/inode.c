@@ -1,23 +1,63 @@
 #include "filesys/inode.h"
-#include <list.h>
+#include <hash.h>
 #include <debug.h>
 #include <round.h>
+#include <stddef.h>
 #include <string.h>
+#include "filesys/cache.h"
 #include "filesys/filesys.h"
 #include "filesys/free-map.h"
 #include "threads/malloc.h"
+#include "threads/synch.h"
 
 /* Identifies an inode. */
 #define INODE_MAGIC 0x494e4f44
 
+/* Number of extents stored in the inode itself. */
+#define DIRECT_EXTENTS 61
+
+/* Number of extents stored in one indirect extent block. */
+#define INDIRECT_EXTENTS 63
+
+/* Minimum number of sectors allocated when a write extends a
+   file.  Sectors past the end of file are released when the
+   file is last closed. */
+#define PREALLOC_SECTORS 8
+
+/* A run of consecutive data sectors. */
+struct extent
+  {
+    block_sector_t start;               /* First sector. */
+    block_sector_t length;              /* Number of sectors. */
+  };
+
 /* On-disk inode.
-   Must be exactly BLOCK_SECTOR_SIZE bytes long. */
+   Must be exactly BLOCK_SECTOR_SIZE bytes long.
+   The file's data is a list of extents.  The first DIRECT_EXTENTS
+   are stored here, the rest in a chain of indirect extent blocks
+   starting at INDIRECT.
+   Sectors are not zeroed when they are allocated.  Instead, the
+   bytes from INIT_LENGTH to LENGTH read as zeros without touching
+   the disk, and a sector is zeroed only when a write first
+   reaches past it without overwriting all of it. */
 struct inode_disk
   {
-    block_sector_t start;               /* First data sector. */
     off_t length;                       /* File size in bytes. */
     unsigned magic;                     /* Magic number. */
-    uint32_t unused[125];               /* Not used. */
+    uint32_t sector_cnt;                /* Number of data sectors. */
+    uint32_t extent_cnt;                /* Number of extents. */
+    block_sector_t indirect;            /* First extent block, 0 if none. */
+    struct extent extents[DIRECT_EXTENTS]; /* First extents. */
+    off_t init_length;                  /* Bytes written or zeroed. */
+  };
+
+/* Indirect extent block.
+   Must be exactly BLOCK_SECTOR_SIZE bytes long. */
+struct extent_block
+  {
+    block_sector_t next;                /* Next extent block, 0 if none. */
+    uint32_t unused;                    /* Not used. */
+    struct extent extents[INDIRECT_EXTENTS]; /* Extents. */
   };
 
 /* Returns the number of sectors to allocate for an inode SIZE
@@ -31,7 +71,12 @@ bytes_to_sectors (off_t size)
 /* In-memory inode. */
 struct inode 
   {
-    struct list_elem elem;              /* Element in inode list. */
+    struct hash_elem elem;              /* Element in open_inodes. */
+    struct lock load_lock;              /* Held while DATA is read. */
+    struct rwlock rw;                   /* Protects DATA and DENY_WRITE_CNT. */
+    struct lock dir_lock;               /* Serializes directory updates. */
+    struct lock init_lock;              /* Serializes writes past
+                                           DATA.INIT_LENGTH. */
     block_sector_t sector;              /* Sector number of disk location. */
     int open_cnt;                       /* Number of openers. */
     bool removed;                       /* True if deleted, false otherwise. */
@@ -39,29 +84,261 @@ struct inode
     struct inode_disk data;             /* Inode content. */
   };
 
+/* Returns the sector of the extent block that holds extent IDX
+   of DISK, which must be an indirect extent, and stores the
+   extent's slot in that block in *SLOT.  If ALLOCATE is true,
+   missing extent blocks are allocated and linked into the chain.
+   Returns 0 if the block does not exist or cannot be allocated. */
+static block_sector_t
+extent_block (struct inode_disk *disk, size_t idx, size_t *slot,
+              bool allocate)
+{
+  static char zeros[BLOCK_SECTOR_SIZE];
+  block_sector_t *link = &disk->indirect;
+  block_sector_t link_sector = 0;
+  block_sector_t sector = disk->indirect;
+  size_t block;
+
+  ASSERT (idx >= DIRECT_EXTENTS);
+  idx -= DIRECT_EXTENTS;
+  *slot = idx % INDIRECT_EXTENTS;
+
+  for (block = 0; ; block++)
+    {
+      if (sector == 0)
+        {
+          /* Append a new block to the chain. */
+          if (!allocate || !free_map_allocate (1, &sector))
+            return 0;
+          cache_write (sector, zeros, 0, BLOCK_SECTOR_SIZE);
+          if (link_sector == 0)
+            *link = sector;
+          else
+            cache_write (link_sector, &sector,
+                         offsetof (struct extent_block, next),
+                         sizeof sector);
+        }
+      if (block == idx / INDIRECT_EXTENTS)
+        return sector;
+      link_sector = sector;
+      cache_read (sector, &sector, offsetof (struct extent_block, next),
+                  sizeof sector);
+    }
+}
+
+/* Reads extent IDX of DISK into *E. */
+static void
+get_extent (struct inode_disk *disk, size_t idx, struct extent *e)
+{
+  block_sector_t sector;
+  size_t slot;
+
+  ASSERT (idx < disk->extent_cnt);
+  if (idx < DIRECT_EXTENTS)
+    {
+      *e = disk->extents[idx];
+      return;
+    }
+  sector = extent_block (disk, idx, &slot, false);
+  ASSERT (sector != 0);
+  cache_read (sector, e, offsetof (struct extent_block, extents)
+              + slot * sizeof *e, sizeof *e);
+}
+
+/* Stores *E as extent IDX of DISK, allocating an extent block if
+   needed.  Returns false if the extent block cannot be
+   allocated. */
+static bool
+set_extent (struct inode_disk *disk, size_t idx, const struct extent *e)
+{
+  block_sector_t sector;
+  size_t slot;
+
+  if (idx < DIRECT_EXTENTS)
+    {
+      disk->extents[idx] = *e;
+      return true;
+    }
+  sector = extent_block (disk, idx, &slot, true);
+  if (sector == 0)
+    return false;
+  cache_write (sector, e, offsetof (struct extent_block, extents)
+               + slot * sizeof *e, sizeof *e);
+  return true;
+}
+
 /* Returns the block device sector that contains byte offset POS
    within INODE.
    Returns -1 if INODE does not contain data for a byte at offset
    POS. */
 static block_sector_t
-byte_to_sector (const struct inode *inode, off_t pos) 
+byte_to_sector (struct inode *inode, off_t pos) 
 {
+  size_t idx = pos / BLOCK_SECTOR_SIZE;
+  size_t i;
+
   ASSERT (inode != NULL);
-  if (pos < inode->data.length)
-    return inode->data.start + pos / BLOCK_SECTOR_SIZE;
-  else
+  if (pos >= inode->data.length)
     return -1;
+
+  for (i = 0; i < inode->data.extent_cnt; i++)
+    {
+      struct extent e;
+      get_extent (&inode->data, i, &e);
+      if (idx < e.length)
+        return e.start + idx;
+      idx -= e.length;
+    }
+  NOT_REACHED ();
+}
+
+/* Writes zeros to CNT sectors starting at SECTOR. */
+static void
+zero_sectors (block_sector_t sector, size_t cnt)
+{
+  static char zeros[BLOCK_SECTOR_SIZE];
+  size_t i;
+
+  for (i = 0; i < cnt; i++)
+    cache_write (sector + i, zeros, 0, BLOCK_SECTOR_SIZE);
+}
+
+/* Grows DISK so that it holds LENGTH bytes.  New sectors are not
+   zeroed; see struct inode_disk.  Extends the last extent in
+   place when the sectors after it are free, so that files written
+   sequentially stay contiguous; otherwise adds the largest new
+   extent that the free map can supply.  If PREALLOC is true,
+   allocates at least PREALLOC_SECTORS at a time, so that small
+   appends interleaved with other files still get long runs.
+   Returns false if the disk is full, in which case DISK keeps its
+   old length. */
+static bool
+inode_grow (struct inode_disk *disk, off_t length, bool prealloc)
+{
+  size_t need = bytes_to_sectors (length);
+
+  while (disk->sector_cnt < need)
+    {
+      size_t cnt = need - disk->sector_cnt;
+      struct extent e;
+
+      if (prealloc && cnt < PREALLOC_SECTORS)
+        cnt = PREALLOC_SECTORS;
+      size_t got = 0;
+
+      if (disk->extent_cnt > 0)
+        {
+          get_extent (disk, disk->extent_cnt - 1, &e);
+          got = free_map_extend (e.start + e.length, cnt);
+        }
+      if (got > 0)
+        {
+          e.length += got;
+          set_extent (disk, disk->extent_cnt - 1, &e);
+        }
+      else
+        {
+          for (got = cnt; got > 0; got /= 2)
+            if (free_map_allocate (got, &e.start))
+              break;
+          if (got == 0)
+            return false;
+          e.length = got;
+          if (!set_extent (disk, disk->extent_cnt, &e))
+            {
+              free_map_release (e.start, got);
+              return false;
+            }
+          disk->extent_cnt++;
+        }
+      disk->sector_cnt += got;
+    }
+
+  if (length > disk->length)
+    disk->length = length;
+  return true;
+}
+
+/* Releases the data sectors and extent blocks of DISK. */
+static void
+inode_release (struct inode_disk *disk)
+{
+  block_sector_t sector = disk->indirect;
+  size_t i;
+
+  for (i = 0; i < disk->extent_cnt; i++)
+    {
+      struct extent e;
+      get_extent (disk, i, &e);
+      free_map_release (e.start, e.length);
+    }
+  while (sector != 0)
+    {
+      block_sector_t next;
+      cache_read (sector, &next, offsetof (struct extent_block, next),
+                  sizeof next);
+      free_map_release (sector, 1);
+      sector = next;
+    }
+}
+
+/* Releases the sectors of INODE past its end of file, which a
+   write preallocated, and writes INODE back. */
+static void
+inode_trim (struct inode *inode)
+{
+  struct inode_disk *disk = &inode->data;
+  size_t extra = disk->sector_cnt - bytes_to_sectors (disk->length);
+
+  while (extra > 0)
+    {
+      struct extent e;
+      size_t cnt;
+
+      get_extent (disk, disk->extent_cnt - 1, &e);
+      cnt = e.length < extra ? e.length : extra;
+      e.length -= cnt;
+      free_map_release (e.start + e.length, cnt);
+      if (e.length == 0)
+        disk->extent_cnt--;
+      else
+        set_extent (disk, disk->extent_cnt - 1, &e);
+      disk->sector_cnt -= cnt;
+      extra -= cnt;
+    }
+  cache_write (inode->sector, disk, 0, BLOCK_SECTOR_SIZE);
+}
+
+/* Open inodes, keyed by sector, so that opening a single inode
+   twice returns the same `struct inode'. */
+static struct hash open_inodes;
+
+/* Protects open_inodes and the open counts of its inodes.  Never
+   held across disk I/O, so opens of different inodes do not wait
+   for each other. */
+static struct lock open_inodes_lock;
+
+static unsigned
+inode_hash (const struct hash_elem *e, void *aux UNUSED)
+{
+  return hash_int (hash_entry (e, struct inode, elem)->sector);
 }
 
-/* List of open inodes, so that opening a single inode twice
-   returns the same `struct inode'. */
-static struct list open_inodes;
+static bool
+inode_less (const struct hash_elem *a, const struct hash_elem *b,
+            void *aux UNUSED)
+{
+  return (hash_entry (a, struct inode, elem)->sector
+          < hash_entry (b, struct inode, elem)->sector);
+}
 
 /* Initializes the inode module. */
 void
 inode_init (void) 
 {
-  list_init (&open_inodes);
+  ASSERT (sizeof (struct extent_block) == BLOCK_SECTOR_SIZE);
+  hash_init (&open_inodes, inode_hash, inode_less, NULL);
+  lock_init (&open_inodes_lock);
 }
 
 /* Initializes an inode with LENGTH bytes of data and
@@ -84,22 +361,14 @@ inode_create (block_sector_t sector, off_t length)
   disk_inode = calloc (1, sizeof *disk_inode);
   if (disk_inode != NULL)
     {
-      size_t sectors = bytes_to_sectors (length);
-      disk_inode->length = length;
       disk_inode->magic = INODE_MAGIC;
-      if (free_map_allocate (sectors, &disk_inode->start)) 
+      if (inode_grow (disk_inode, length, false)) 
         {
-          block_write (fs_device, sector, disk_inode);
-          if (sectors > 0) 
-            {
-              static char zeros[BLOCK_SECTOR_SIZE];
-              size_t i;
-              
-              for (i = 0; i < sectors; i++) 
-                block_write (fs_device, disk_inode->start + i, zeros);
-            }
+          cache_write (sector, disk_inode, 0, BLOCK_SECTOR_SIZE);
           success = true; 
         } 
+      else
+        inode_release (disk_inode);
       free (disk_inode);
     }
   return success;
@@ -111,33 +380,49 @@ inode_create (block_sector_t sector, off_t length)
 struct inode *
 inode_open (block_sector_t sector)
 {
-  struct list_elem *e;
+  struct inode key;
+  struct hash_elem *e;
   struct inode *inode;
 
   /* Check whether this inode is already open. */
-  for (e = list_begin (&open_inodes); e != list_end (&open_inodes);
-       e = list_next (e)) 
+  key.sector = sector;
+  lock_acquire (&open_inodes_lock);
+  e = hash_find (&open_inodes, &key.elem);
+  if (e != NULL)
     {
-      inode = list_entry (e, struct inode, elem);
-      if (inode->sector == sector) 
-        {
-          inode_reopen (inode);
-          return inode; 
-        }
+      inode = hash_entry (e, struct inode, elem);
+      inode->open_cnt++;
+      lock_release (&open_inodes_lock);
+
+      /* Wait until its first opener has read it. */
+      lock_acquire (&inode->load_lock);
+      lock_release (&inode->load_lock);
+      return inode;
     }
 
   /* Allocate memory. */
   inode = malloc (sizeof *inode);
   if (inode == NULL)
-    return NULL;
+    {
+      lock_release (&open_inodes_lock);
+      return NULL;
+    }
 
   /* Initialize. */
-  list_push_front (&open_inodes, &inode->elem);
   inode->sector = sector;
   inode->open_cnt = 1;
   inode->deny_write_cnt = 0;
   inode->removed = false;
-  block_read (fs_device, inode->sector, &inode->data);
+  rwlock_init (&inode->rw);
+  lock_init (&inode->dir_lock);
+  lock_init (&inode->init_lock);
+  lock_init (&inode->load_lock);
+  lock_acquire (&inode->load_lock);
+  hash_insert (&open_inodes, &inode->elem);
+  lock_release (&open_inodes_lock);
+
+  cache_read (inode->sector, &inode->data, 0, BLOCK_SECTOR_SIZE);
+  lock_release (&inode->load_lock);
   return inode;
 }
 
@@ -146,7 +431,11 @@ struct inode *
 inode_reopen (struct inode *inode)
 {
   if (inode != NULL)
-    inode->open_cnt++;
+    {
+      lock_acquire (&open_inodes_lock);
+      inode->open_cnt++;
+      lock_release (&open_inodes_lock);
+    }
   return inode;
 }
 
@@ -168,21 +457,36 @@ inode_close (struct inode *inode)
     return;
 
   /* Release resources if this was the last opener. */
-  if (--inode->open_cnt == 0)
+  lock_acquire (&open_inodes_lock);
+  if (--inode->open_cnt == 0 && !inode->removed
+      && inode->data.sector_cnt > bytes_to_sectors (inode->data.length))
+    {
+      /* Release preallocated sectors.  The inode stays in the
+         table meanwhile, and anyone reopening it waits on
+         LOAD_LOCK as if it were being read. */
+      lock_acquire (&inode->load_lock);
+      lock_release (&open_inodes_lock);
+      inode_trim (inode);
+      lock_acquire (&open_inodes_lock);
+      lock_release (&inode->load_lock);
+    }
+  if (inode->open_cnt == 0)
     {
-      /* Remove from inode list and release lock. */
-      list_remove (&inode->elem);
+      /* Remove from inode table and release lock. */
+      hash_delete (&open_inodes, &inode->elem);
+      lock_release (&open_inodes_lock);
  
       /* Deallocate blocks if removed. */
       if (inode->removed) 
         {
           free_map_release (inode->sector, 1);
-          free_map_release (inode->data.start,
-                            bytes_to_sectors (inode->data.length)); 
+          inode_release (&inode->data);
         }
 
       free (inode); 
     }
+  else
+    lock_release (&open_inodes_lock);
 }
 
 /* Marks INODE to be deleted when it is closed by the last caller who
@@ -202,8 +506,8 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
 {
   uint8_t *buffer = buffer_;
   off_t bytes_read = 0;
-  uint8_t *bounce = NULL;
 
+  rwlock_acquire_read (&inode->rw);
   while (size > 0) 
     {
       /* Disk sector to read, starting byte offset within sector. */
@@ -220,55 +524,118 @@ inode_read_at (struct inode *inode, void *buffer_, off_t size, off_t offset)
       if (chunk_size <= 0)
         break;
 
-      if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
-        {
-          /* Read full sector directly into caller's buffer. */
-          block_read (fs_device, sector_idx, buffer + bytes_read);
-        }
-      else 
-        {
-          /* Read sector into bounce buffer, then partially copy
-             into caller's buffer. */
-          if (bounce == NULL) 
-            {
-              bounce = malloc (BLOCK_SECTOR_SIZE);
-              if (bounce == NULL)
-                break;
-            }
-          block_read (fs_device, sector_idx, bounce);
-          memcpy (buffer + bytes_read, bounce + sector_ofs, chunk_size);
-        }
+      /* Copy the chunk out of the buffer cache, unless it has
+         never been written. */
+      if ((size_t) (offset / BLOCK_SECTOR_SIZE)
+          >= bytes_to_sectors (inode->data.init_length))
+        memset (buffer + bytes_read, 0, chunk_size);
+      else
+        cache_read (sector_idx, buffer + bytes_read, sector_ofs, chunk_size);
       
       /* Advance. */
       size -= chunk_size;
       offset += chunk_size;
       bytes_read += chunk_size;
     }
-  free (bounce);
+  rwlock_release_read (&inode->rw);
 
   return bytes_read;
 }
 
+/* Starts reading the sectors of INODE that hold the SIZE bytes at
+   OFFSET into the buffer cache, without waiting for them. */
+void
+inode_readahead (struct inode *inode, off_t size, off_t offset)
+{
+  off_t end, ofs;
+
+  rwlock_acquire_read (&inode->rw);
+  end = offset + size;
+  if (end > inode->data.init_length)
+    end = inode->data.init_length;
+  for (ofs = offset - offset % BLOCK_SECTOR_SIZE; ofs < end;
+       ofs += BLOCK_SECTOR_SIZE)
+    cache_readahead (byte_to_sector (inode, ofs));
+  rwlock_release_read (&inode->rw);
+}
+
+/* Writes the SIZE bytes in CHUNK, which lie within one sector,
+   at OFFSET in INODE, where they end past the initialized part of
+   INODE.  Zeros the sectors between the initialized part and
+   OFFSET, and OFFSET's sector too unless CHUNK covers all of it,
+   then advances the initialized part to the end of CHUNK.
+   Returns false if writes to INODE are denied.
+
+   Holds INODE only for reading, so that writing back a dirty
+   page of a memory-mapped file never waits on a reader whose copy
+   into a user buffer is itself faulting on that page.  INODE's
+   init_lock orders the writers past the initialized part; readers
+   see the new sectors only once they are zeroed and written. */
+static bool
+write_uninit (struct inode *inode, const void *chunk, int size,
+              off_t offset)
+{
+  uint8_t bounce[BLOCK_SECTOR_SIZE];
+  struct inode_disk *disk = &inode->data;
+  size_t idx = offset / BLOCK_SECTOR_SIZE;
+  size_t i;
+
+  /* Copying a user CHUNK may fault, and the fault may write back
+     a page of INODE, so copy it before taking init_lock. */
+  memcpy (bounce, chunk, size);
+
+  rwlock_acquire_read (&inode->rw);
+  if (inode->deny_write_cnt)
+    {
+      rwlock_release_read (&inode->rw);
+      return false;
+    }
+  lock_acquire (&inode->init_lock);
+  for (i = bytes_to_sectors (disk->init_length); i <= idx; i++)
+    if (i < idx || size < BLOCK_SECTOR_SIZE)
+      zero_sectors (byte_to_sector (inode, i * BLOCK_SECTOR_SIZE), 1);
+  cache_write (byte_to_sector (inode, offset), bounce,
+               offset % BLOCK_SECTOR_SIZE, size);
+  if (offset + size > disk->init_length)
+    {
+      disk->init_length = offset + size;
+      cache_write (inode->sector, disk, 0, BLOCK_SECTOR_SIZE);
+    }
+  lock_release (&inode->init_lock);
+  rwlock_release_read (&inode->rw);
+  return true;
+}
+
 /* Writes SIZE bytes from BUFFER into INODE, starting at OFFSET.
    Returns the number of bytes actually written, which may be
-   less than SIZE if end of file is reached or an error occurs.
-   (Normally a write at end of file would extend the inode, but
-   growth is not yet implemented.) */
+   less than SIZE if an error occurs.  A write past end of file
+   extends the inode; if the disk is full, nothing is written.
+   Extending INODE excludes other readers and writers of INODE;
+   other writes hold INODE for reading. */
 off_t
 inode_write_at (struct inode *inode, const void *buffer_, off_t size,
                 off_t offset) 
 {
   const uint8_t *buffer = buffer_;
   off_t bytes_written = 0;
-  uint8_t *bounce = NULL;
 
-  if (inode->deny_write_cnt)
-    return 0;
+  if (offset + size > inode_length (inode))
+    {
+      bool grown;
+
+      rwlock_acquire_write (&inode->rw);
+      grown = (inode->deny_write_cnt == 0
+               && inode_grow (&inode->data, offset + size, true));
+      if (grown)
+        cache_write (inode->sector, &inode->data, 0, BLOCK_SECTOR_SIZE);
+      rwlock_release_write (&inode->rw);
+      if (!grown)
+        return 0;
+    }
 
   while (size > 0) 
     {
-      /* Sector to write, starting byte offset within sector. */
-      block_sector_t sector_idx = byte_to_sector (inode, offset);
+      /* Starting byte offset within sector. */
       int sector_ofs = offset % BLOCK_SECTOR_SIZE;
 
       /* Bytes left in inode, bytes left in sector, lesser of the two. */
@@ -281,30 +648,25 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
       if (chunk_size <= 0)
         break;
 
-      if (sector_ofs == 0 && chunk_size == BLOCK_SECTOR_SIZE)
+      /* Copy the chunk into the buffer cache.  A partial sector
+         is read in first, a full one is not. */
+      if (offset + chunk_size > inode->data.init_length)
         {
-          /* Write full sector directly to disk. */
-          block_write (fs_device, sector_idx, buffer + bytes_written);
+          if (!write_uninit (inode, buffer + bytes_written, chunk_size,
+                             offset))
+            break;
         }
-      else 
+      else
         {
-          /* We need a bounce buffer. */
-          if (bounce == NULL) 
+          rwlock_acquire_read (&inode->rw);
+          if (inode->deny_write_cnt)
             {
-              bounce = malloc (BLOCK_SECTOR_SIZE);
-              if (bounce == NULL)
-                break;
+              rwlock_release_read (&inode->rw);
+              break;
             }
-
-          /* If the sector contains data before or after the chunk
-             we're writing, then we need to read in the sector
-             first.  Otherwise we start with a sector of all zeros. */
-          if (sector_ofs > 0 || chunk_size < sector_left) 
-            block_read (fs_device, sector_idx, bounce);
-          else
-            memset (bounce, 0, BLOCK_SECTOR_SIZE);
-          memcpy (bounce + sector_ofs, buffer + bytes_written, chunk_size);
-          block_write (fs_device, sector_idx, bounce);
+          cache_write (byte_to_sector (inode, offset),
+                       buffer + bytes_written, sector_ofs, chunk_size);
+          rwlock_release_read (&inode->rw);
         }
 
       /* Advance. */
@@ -312,7 +674,6 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
       offset += chunk_size;
       bytes_written += chunk_size;
     }
-  free (bounce);
 
   return bytes_written;
 }
@@ -322,8 +683,10 @@ inode_write_at (struct inode *inode, const void *buffer_, off_t size,
 void
 inode_deny_write (struct inode *inode) 
 {
+  rwlock_acquire_write (&inode->rw);
   inode->deny_write_cnt++;
   ASSERT (inode->deny_write_cnt <= inode->open_cnt);
+  rwlock_release_write (&inode->rw);
 }
 
 /* Re-enables writes to INODE.
@@ -332,9 +695,11 @@ inode_deny_write (struct inode *inode)
 void
 inode_allow_write (struct inode *inode) 
 {
+  rwlock_acquire_write (&inode->rw);
   ASSERT (inode->deny_write_cnt > 0);
   ASSERT (inode->deny_write_cnt <= inode->open_cnt);
   inode->deny_write_cnt--;
+  rwlock_release_write (&inode->rw);
 }
 
 /* Returns the length, in bytes, of INODE's data. */
@@ -343,3 +708,18 @@ inode_length (const struct inode *inode)
 {
   return inode->data.length;
 }
+
+/* Acquires the lock that serializes updates of the directory
+   stored in INODE. */
+void
+inode_lock (struct inode *inode)
+{
+  lock_acquire (&inode->dir_lock);
+}
+
+/* Releases INODE's directory lock. */
+void
+inode_unlock (struct inode *inode)
+{
+  lock_release (&inode->dir_lock);
+}
@@ -8,6 +8,7 @@ enum
     SYS_HALT,                   /* Halt the operating system. */
     SYS_EXIT,                   /* Terminate this process. */
     SYS_EXEC,                   /* Start another process. */
+    SYS_FORK,                   /* Clone the current process. */
     SYS_WAIT,                   /* Wait for a child process to die. */
     SYS_CREATE,                 /* Create a file. */
     SYS_REMOVE,                 /* Delete a file. */
@@ -20,6 +21,7 @@ enum
     SYS_CLOSE,                  /* Close a file. */
     SYS_FIBONACCI,               /* Fibonacci function. */
     SYS_MAX_OF_FOUR_INT,        /* Max of four integers. */
+    SYS_TICKS,                  /* Timer ticks since boot. */
 
     /* Project 3 and optionally project 4. */
     SYS_MMAP,                   /* Map a file into memory. */
@@ -97,6 +97,12 @@ exec (const char *file)
   return (pid_t) syscall1 (SYS_EXEC, file);
 }
 
+pid_t
+fork (void)
+{
+  return (pid_t) syscall0 (SYS_FORK);
+}
+
 int
 wait (pid_t pid)
 {
@@ -205,4 +211,8 @@ int fibonacci(int n){
 
 int max_of_four_int(int a, int b, int c, int d){
   return syscall4(SYS_MAX_OF_FOUR_INT, a, b, c, d);
-}
\ No newline at end of file
+}
+
+int ticks(void){
+  return syscall0(SYS_TICKS);
+}
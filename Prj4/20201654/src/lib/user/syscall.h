@@ -23,6 +23,7 @@ typedef int mapid_t;
 void halt (void) NO_RETURN;
 void exit (int status) NO_RETURN;
 pid_t exec (const char *file);
+pid_t fork (void);
 int wait (pid_t);
 bool create (const char *file, unsigned initial_size);
 bool remove (const char *file);
@@ -36,6 +37,7 @@ void close (int fd);
 
 int fibonacci(int n);
 int max_of_four_int(int a, int b, int c, int d);
+int ticks(void);
 
 /* Project 3 and optionally project 4. */
 mapid_t mmap (int fd, void *addr);
@@ -0,0 +1,36 @@
+/* Creates many small files, each with a little data written to
+   it.  Every create allocates an inode sector and every write a
+   data sector, so dividing the "sectors written" count in the
+   kernel's "Free map:" statistics by FILE_CNT gives the free map
+   sectors written per create. */
+
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_CNT 1000
+
+static char buf[16];
+
+void
+test_main (void)
+{
+  char name[16];
+  int i;
+
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      int fd;
+
+      snprintf (name, sizeof name, "f%d", i);
+      if (!create (name, 0))
+        fail ("create \"%s\"", name);
+      if ((fd = open (name)) < 2)
+        fail ("open \"%s\"", name);
+      if (write (fd, buf, sizeof buf) != sizeof buf)
+        fail ("write \"%s\"", name);
+      close (fd);
+    }
+  msg ("created %d files", FILE_CNT);
+}
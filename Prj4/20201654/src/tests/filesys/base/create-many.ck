@@ -0,0 +1,10 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(create-many) begin
+(create-many) created 1000 files
+(create-many) end
+EOF
+pass;
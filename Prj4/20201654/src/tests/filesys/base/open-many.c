@@ -0,0 +1,37 @@
+/* Creates many empty files in the root directory and then opens
+   each of them.  With a linear directory every open reads the
+   entries before it; compare the kernel's "Cache:" statistics
+   against a run with a small FILE_CNT. */
+
+#include <stdio.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define FILE_CNT 1000
+
+void
+test_main (void)
+{
+  char name[16];
+  int i;
+
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      snprintf (name, sizeof name, "o%d", i);
+      if (!create (name, 0))
+        fail ("create \"%s\"", name);
+    }
+  msg ("created %d files", FILE_CNT);
+
+  for (i = 0; i < FILE_CNT; i++)
+    {
+      int fd;
+
+      snprintf (name, sizeof name, "o%d", i);
+      if ((fd = open (name)) < 2)
+        fail ("open \"%s\"", name);
+      close (fd);
+    }
+  msg ("opened %d files", FILE_CNT);
+}
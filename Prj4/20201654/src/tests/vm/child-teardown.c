@@ -0,0 +1,24 @@
+/* Child process of page-teardown.
+   Dirties every page of a 3 MB buffer and exits, leaving as many
+   resident frames as the user pool allows for process_exit() to
+   release. */
+
+#include "tests/lib.h"
+
+#define SIZE (3 * 1024 * 1024)
+#define PAGE_SIZE 4096
+
+static char buf[SIZE];
+
+int
+main (void)
+{
+  size_t i;
+
+  test_name = "child-teardown";
+
+  for (i = 0; i < SIZE; i += PAGE_SIZE)
+    buf[i] = 0x5a;
+
+  return 0x42;
+}
@@ -0,0 +1,49 @@
+/* Fills a 1 MB buffer, forks, and lets the child overwrite half
+   of it.  Each process must keep seeing its own copy of the
+   buffer, since the pages are shared copy-on-write.  The
+   kernel's "Frame:" statistics count the pages copied. */
+
+#include <string.h>
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (1024 * 1024)
+
+static char buf[SIZE];
+
+/* Fails unless every byte of BUF[OFS, OFS + SIZE) is VALUE. */
+static void
+check (size_t ofs, size_t size, char value)
+{
+  size_t i;
+
+  for (i = ofs; i < ofs + size; i++)
+    if (buf[i] != value)
+      fail ("byte %zu is %d, expected %d", i, buf[i], value);
+}
+
+void
+test_main (void)
+{
+  pid_t child;
+
+  memset (buf, 0x5a, SIZE);
+
+  child = fork ();
+  if (child == 0)
+    {
+      /* Child: quiet, so that the output does not interleave. */
+      quiet = true;
+      check (0, SIZE, 0x5a);
+      memset (buf, 0xa5, SIZE / 2);
+      check (0, SIZE / 2, (char) 0xa5);
+      check (SIZE / 2, SIZE / 2, 0x5a);
+      exit (0x42);
+    }
+
+  CHECK (child != -1, "fork");
+  CHECK (wait (child) == 0x42, "wait for child");
+  check (0, SIZE, 0x5a);
+  msg ("parent's buffer intact");
+}
@@ -0,0 +1,32 @@
+/* Reads every page of a 4 MB BSS array, which must read as zeros,
+   and then writes to a few of its pages.  With a user pool far
+   smaller than the array, this only works without heavy swapping
+   if the untouched pages share the zero frame; see the
+   "zero-mapped" count in the kernel's "Frame:" statistics. */
+
+#include <string.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define SIZE (4 * 1024 * 1024)
+#define PAGE_SIZE 4096
+
+static char buf[SIZE];
+
+void
+test_main (void)
+{
+  size_t i;
+
+  for (i = 0; i < SIZE; i += PAGE_SIZE)
+    if (buf[i] != 0)
+      fail ("byte %zu is %d, expected 0", i, buf[i]);
+  msg ("read all pages");
+
+  for (i = 0; i < SIZE; i += 64 * PAGE_SIZE)
+    memset (buf + i, 0x5a, PAGE_SIZE);
+  for (i = 0; i < SIZE; i += PAGE_SIZE)
+    if (buf[i] != (i % (64 * PAGE_SIZE) == 0 ? 0x5a : 0))
+      fail ("byte %zu is %d after writing", i, buf[i]);
+  msg ("wrote sparse pages");
+}
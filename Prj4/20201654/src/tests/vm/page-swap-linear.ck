@@ -0,0 +1,14 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(page-swap-linear) begin
+(page-swap-linear) initialize
+(page-swap-linear) read pass
+(page-swap-linear) read/modify/write pass one
+(page-swap-linear) read/modify/write pass two
+(page-swap-linear) read pass
+(page-swap-linear) end
+EOF
+pass;
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(page-teardown-1024) begin
+(page-teardown-1024) exec "child-teardown"
+(page-teardown-1024) wait for child 0
+(page-teardown-1024) exec "child-teardown"
+(page-teardown-1024) wait for child 1
+(page-teardown-1024) exec "child-teardown"
+(page-teardown-1024) wait for child 2
+(page-teardown-1024) exec "child-teardown"
+(page-teardown-1024) wait for child 3
+(page-teardown-1024) end
+EOF
+pass;
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(page-teardown-256) begin
+(page-teardown-256) exec "child-teardown"
+(page-teardown-256) wait for child 0
+(page-teardown-256) exec "child-teardown"
+(page-teardown-256) wait for child 1
+(page-teardown-256) exec "child-teardown"
+(page-teardown-256) wait for child 2
+(page-teardown-256) exec "child-teardown"
+(page-teardown-256) wait for child 3
+(page-teardown-256) end
+EOF
+pass;
@@ -0,0 +1,17 @@
+# -*- perl -*-
+use strict;
+use warnings;
+use tests::tests;
+check_expected (IGNORE_EXIT_CODES => 1, [<<'EOF']);
+(page-teardown-512) begin
+(page-teardown-512) exec "child-teardown"
+(page-teardown-512) wait for child 0
+(page-teardown-512) exec "child-teardown"
+(page-teardown-512) wait for child 1
+(page-teardown-512) exec "child-teardown"
+(page-teardown-512) wait for child 2
+(page-teardown-512) exec "child-teardown"
+(page-teardown-512) wait for child 3
+(page-teardown-512) end
+EOF
+pass;
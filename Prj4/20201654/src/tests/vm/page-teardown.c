@@ -0,0 +1,26 @@
+/* Runs child-teardown several times in sequence, so that the
+   kernel's "Timer:" and "Frame:" statistics measure the cost of
+   tearing down a large resident address space.  This is built
+   as several tests that differ only in the size of the user
+   pool (-ul); exit time should not grow with the pool size. */
+
+#include <syscall.h>
+#include "tests/lib.h"
+#include "tests/main.h"
+
+#define CHILD_CNT 4
+
+void
+test_main (void)
+{
+  int i;
+
+  for (i = 0; i < CHILD_CNT; i++)
+    {
+      pid_t child;
+
+      CHECK ((child = exec ("child-teardown")) != -1,
+             "exec \"child-teardown\"");
+      CHECK (wait (child) == 0x42, "wait for child %d", i);
+    }
+}
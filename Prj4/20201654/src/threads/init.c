@@ -117,7 +117,6 @@ main (void)
   syscall_init ();
 #endif
   frame_table_init ();
-  swap_init ();
   /* Start thread scheduler and enable interrupts. */
   thread_start ();
   serial_init_queue ();
@@ -130,6 +129,13 @@ main (void)
   filesys_init (format_filesys);
 #endif
 
+#ifdef VM
+  /* Swap needs its block device; then start writing back dirty
+     frames in the background. */
+  swap_init ();
+  frame_cleaner_init ();
+#endif
+
   printf ("Boot complete.\n");
   
   /* Run actions specified on kernel command line. */
@@ -266,6 +272,12 @@ parse_options (char **argv)
 #ifdef USERPROG
       else if (!strcmp (name, "-ul"))
         user_page_limit = atoi (value);
+#endif
+#ifdef VM
+      else if (!strcmp (name, "-spread"))
+        frame_hand_spread = atoi (value);
+      else if (!strcmp (name, "-fault-around"))
+        fault_around_pages = atoi (value);
 #endif
       else
         PANIC ("unknown option `%s' (use -h for help)", name);
@@ -389,6 +401,10 @@ usage (void)
           "  -mlfqs             Use multi-level feedback queue scheduler.\n"
 #ifdef USERPROG
           "  -ul=COUNT          Limit user memory to COUNT pages.\n"
+#endif
+#ifdef VM
+          "  -spread=COUNT      Keep clock hands COUNT frames apart.\n"
+          "  -fault-around=COUNT  Map COUNT more file pages per fault.\n"
 #endif
           );
   shutdown_power_off ();
@@ -7,6 +7,7 @@
 #include "threads/flags.h"
 #include "threads/interrupt.h"
 #include "threads/intr-stubs.h"
+#include "threads/malloc.h"
 #include "threads/palloc.h"
 #include "threads/switch.h"
 #include "threads/synch.h"
@@ -24,8 +25,14 @@
 
 // int load_avg;
 
-/* List of process in THREAD_BLOCKED state*/
-// static struct list sleep_list;
+/* Sleeping threads, kept as a binary min-heap on wakeup_tick so
+   the earliest deadline is always sleepers[0].  next_wakeup caches
+   that deadline (INT64_MAX if nobody sleeps), letting the timer
+   interrupt return at once until something is due. */
+static struct thread **sleepers;
+static size_t sleeper_cnt;      /* Number of sleeping threads. */
+static size_t sleeper_cap;      /* Number of slots in sleepers. */
+static int64_t next_wakeup = INT64_MAX;
 
 /* List of processes in THREAD_READY state, that is, processes
    that are ready to run but not actually running. */
@@ -82,6 +89,9 @@ static void *alloc_frame (struct thread *, size_t size);
 static void schedule (void);
 void thread_schedule_tail (struct thread *prev);
 static tid_t allocate_tid (void);
+static void grow_sleepers (void);
+static void sleepers_push (struct thread *);
+static struct thread *sleepers_pop (void);
 
 /* Initializes the threading system by transforming the code
    that's currently running into a thread.  This can't work in
@@ -102,7 +112,6 @@ thread_init (void)
   ASSERT (intr_get_level () == INTR_OFF);
 
   lock_init (&tid_lock);
-  // list_init (&sleep_list);
   list_init (&ready_list);
   list_init (&all_list);
   /* Set up a thread structure for the running thread. */
@@ -296,6 +305,105 @@ thread_unblock (struct thread *t)
   intr_set_level (old_level);
 }
 
+/* Blocks the current thread until timer_ticks() reaches TICKS. */
+void thread_sleep(int64_t ticks) {
+  struct thread *t = thread_current();
+  // Disable interrupts
+  enum intr_level old_level = intr_disable();
+
+  if (t == idle_thread) {
+    intr_set_level(old_level);
+    return;
+  }
+  // The heap can only grow with interrupts on, so make room first
+  while (sleeper_cnt == sleeper_cap) {
+    intr_set_level(old_level);
+    grow_sleepers();
+    old_level = intr_disable();
+  }
+  t->status = THREAD_BLOCKED;
+  t->wakeup_tick = ticks;
+  sleepers_push(t);
+  schedule();
+
+  // Enable interrupts
+  intr_set_level(old_level);
+}
+
+/* Wakes up every thread whose wakeup tick has passed.  Called by
+   the timer interrupt handler, so it does no work unless the
+   earliest deadline is due. */
+void thread_wakeup(int64_t ticks){
+  if (ticks < next_wakeup)
+    return;
+  while (sleeper_cnt > 0 && sleepers[0]->wakeup_tick <= ticks)
+    thread_unblock(sleepers_pop());
+  next_wakeup = sleeper_cnt > 0 ? sleepers[0]->wakeup_tick : INT64_MAX;
+}
+
+/* Doubles the capacity of the sleepers heap.  The new array is
+   allocated with interrupts on and swapped in with interrupts
+   off, since the timer interrupt may pop from the heap at any
+   time. */
+static void grow_sleepers(void) {
+  size_t cap = sleeper_cap > 0 ? sleeper_cap * 2 : 64;
+  struct thread **new = malloc(cap * sizeof *new);
+  struct thread **old = new;
+  enum intr_level old_level;
+
+  if (new == NULL)
+    PANIC("out of memory for sleeping threads");
+
+  old_level = intr_disable();
+  if (cap > sleeper_cap) {
+    memcpy(new, sleepers, sleeper_cnt * sizeof *new);
+    old = sleepers;
+    sleepers = new;
+    sleeper_cap = cap;
+  }
+  intr_set_level(old_level);
+  free(old);
+}
+
+/* Adds T to the sleepers heap, which must have a free slot. */
+static void sleepers_push(struct thread *t) {
+  size_t i = sleeper_cnt++;
+
+  ASSERT(i < sleeper_cap);
+  while (i > 0 && sleepers[(i - 1) / 2]->wakeup_tick > t->wakeup_tick) {
+    sleepers[i] = sleepers[(i - 1) / 2];
+    i = (i - 1) / 2;
+  }
+  sleepers[i] = t;
+  if (t->wakeup_tick < next_wakeup)
+    next_wakeup = t->wakeup_tick;
+}
+
+/* Removes and returns the thread with the earliest wakeup tick
+   from the sleepers heap, which must not be empty. */
+static struct thread *sleepers_pop(void) {
+  struct thread *min = sleepers[0];
+  struct thread *last;
+  size_t i = 0;
+
+  ASSERT(sleeper_cnt > 0);
+  last = sleepers[--sleeper_cnt];
+  for (;;) {
+    size_t child = 2 * i + 1;
+    if (child >= sleeper_cnt)
+      break;
+    if (child + 1 < sleeper_cnt
+        && sleepers[child + 1]->wakeup_tick < sleepers[child]->wakeup_tick)
+      child++;
+    if (sleepers[child]->wakeup_tick >= last->wakeup_tick)
+      break;
+    sleepers[i] = sleepers[child];
+    i = child;
+  }
+  sleepers[i] = last;
+  return min;
+}
+
 /* Returns the name of the running thread. */
 const char *
 thread_name (void) 
@@ -688,6 +796,10 @@ void init_userprog(struct thread *t) {
 
     list_init (&(t->mmap_list));
     t->max_mapid = 0;
+
+    // swap readahead starts with one page and never stops entirely
+    t->swap_ra_next = NULL;
+    t->swap_ra_window = 1;
   #endif
 }
 
@@ -104,7 +104,7 @@ struct thread
 
     /* Shared between thread.c and synch.c. */
     struct list_elem elem;              /* List element. */
-   //  int64_t wakeup_tick;
+    int64_t wakeup_tick;                /* Tick to wake up at, if sleeping. */
     /* Exit Status */
     int exit_status;
 
@@ -121,8 +121,10 @@ struct thread
     struct semaphore load_lock;
     struct thread *parent;
    struct file *file;   /*mapped file in this thread*/
-   struct hash page_table;
+   struct list page_table; /* vm_regions, sorted by address */
    struct list mmap_list;
+   void *swap_ra_next;  /* Swap fault address that continues a sequential scan. */
+   size_t swap_ra_window; /* # of pages to read ahead on a swap fault. */
     int flag;
 #endif
    //  int nice;
@@ -156,9 +158,8 @@ struct thread *thread_current (void);
 tid_t thread_tid (void);
 const char *thread_name (void);
 
-// void thread_sleep (int64_t ticks);
-// void thread_wakeup (int64_t ticks);
-// struct list* get_sleep_list(void);
+void thread_sleep (int64_t ticks);
+void thread_wakeup (int64_t ticks);
 // struct list* get_ready_list(void);
 // struct list* get_all_list(void);
 // struct thread* get_idle_thread(void);
@@ -8,6 +8,7 @@
 #include "threads/vaddr.h"
 #include "userprog/syscall.h"
 #include "vm/page.h"
+#include "vm/frame.h"
 
 /* Number of page faults processed. */
 static long long page_fault_cnt;
@@ -153,10 +154,15 @@ page_fault (struct intr_frame *f)
 
    // valid한 주소인지 확인 + page fault가 발생했는데 page가 할당되어 있다면 잘못된 것이기 때문에 Exit
    if (!is_user_vaddr(fault_addr)) Exit(-1);
-   if (!not_present) Exit(-1);
+   if (!not_present) {
+      // writing a read-only page is only allowed if it is copy-on-write
+      struct PTE *pte = page_lookup(fault_addr);
+      if (!write || pte == NULL || !page_writable(pte) || !cow_fault(pte)) Exit(-1);
+      return;
+   }
    struct PTE *pte = page_lookup(fault_addr);
-   if(pte == NULL && !stack_growth(fault_addr, f->esp)) Exit(-1);
-   else if(pte != NULL && !handle_mm_fault(pte)) Exit(-1);
+   if(pte == NULL && stack_growth(fault_addr, f->esp)) pte = page_lookup(fault_addr);
+   if(pte == NULL || !handle_mm_fault(pte, write)) Exit(-1);
 //   /* To implement virtual memory, delete the rest of the function
 //      body, and replace it with code that brings in the page to
 //      which fault_addr refers. */
@@ -22,9 +22,20 @@
 #include "vm/swap.h"
 
 
+/* Largest swap readahead window, in pages. */
+#define SWAP_RA_MAX 16
+
+/* Number of following file-backed pages to map on a LOAD or
+   MEMMAP fault.  0 disables fault-around. */
+size_t fault_around_pages = 4;
+
 static thread_func start_process NO_RETURN;
+static thread_func start_fork NO_RETURN;
+static struct thread *find_child (tid_t tid);
+static bool fork_process (struct thread *parent);
+static void swap_readahead (void *upage, size_t slot);
+static void fault_around (struct PTE *pte);
 static bool load (const char *cmdline, void (**eip) (void), void **esp);
-extern struct lock filesys_lock;
 /* Starts a new thread running a user program loaded from
    FILENAME.  The new thread may be scheduled (and may even exit)
    before process_execute() returns.  Returns the new process's
@@ -51,17 +62,7 @@ process_execute (const char *file_name)
 
   /* Create a new thread to execute FILE_NAME. */
   tid = thread_create (cmd, PRI_DEFAULT, start_process, fn_copy);
-  struct thread *t;
-  struct list_elem *e;
-  struct thread *child_t = NULL;
-  
-  for(e = list_begin(&thread_current()->children); e != list_end(&thread_current()->children); e = list_next(e)) {
-    t = list_entry(e, struct thread, child);
-    if(t->tid == tid) {
-      child_t = t;
-      break;
-    }
-  }
+  struct thread *child_t = find_child (tid);
 
   sema_down(&child_t->load_lock);
 
@@ -71,6 +72,102 @@ process_execute (const char *file_name)
   return tid;
 }
 
+/* Returns the child of the current thread with thread id TID,
+   or NULL if there is none. */
+static struct thread *
+find_child (tid_t tid)
+{
+  struct list *children = &thread_current ()->children;
+  struct list_elem *e;
+
+  for (e = list_begin (children); e != list_end (children); e = list_next (e))
+    {
+      struct thread *t = list_entry (e, struct thread, child);
+      if (t->tid == tid)
+        return t;
+    }
+  return NULL;
+}
+
+/* Starts a copy of the current process, which made the fork
+   system call with interrupt frame PARENT_IF.  The copy shares
+   the parent's pages copy-on-write and returns 0 from fork().
+   Returns the copy's thread id, or TID_ERROR if it cannot be
+   created. */
+tid_t
+process_fork (struct intr_frame *parent_if)
+{
+  tid_t tid = thread_create (thread_name (), PRI_DEFAULT, start_fork,
+                             parent_if);
+  if (tid == TID_ERROR)
+    return TID_ERROR;
+
+  /* PARENT_IF lives on our stack: wait until the child copied it. */
+  struct thread *child_t = find_child (tid);
+  sema_down (&child_t->load_lock);
+  if (child_t->flag == 0)
+    return TID_ERROR;
+  return tid;
+}
+
+/* A thread function that copies the parent's address space and
+   open files and returns to user mode where the parent made the
+   fork system call. */
+static void
+start_fork (void *parent_if_)
+{
+  struct thread *cur = thread_current ();
+  struct intr_frame if_;
+  bool success;
+
+  memcpy (&if_, parent_if_, sizeof if_);
+  page_table_init (&cur->page_table);
+  success = fork_process (cur->parent);
+
+  cur->flag = success;
+  sema_up (&cur->load_lock);
+  if (!success)
+    Exit (-1);
+
+  /* The child returns 0 from fork(). */
+  if_.eax = 0;
+  asm volatile ("movl %0, %%esp; jmp intr_exit" : : "g" (&if_) : "memory");
+  NOT_REACHED ();
+}
+
+/* Gives the current thread a page directory, open files, and
+   pages copied from PARENT.  Returns true if successful. */
+static bool
+fork_process (struct thread *parent)
+{
+  struct thread *cur = thread_current ();
+  bool success = true;
+  int i;
+
+  cur->pagedir = pagedir_create ();
+  if (cur->pagedir == NULL)
+    return false;
+  process_activate ();
+
+  /* PARENT waits until we are done, so its files do not change
+     under us. */
+  cur->file = file_reopen (parent->file);
+  for (i = 3; i < 128; i++)
+    if (parent->fd_table[i] != NULL)
+      {
+        cur->fd_table[i] = file_reopen (parent->fd_table[i]);
+        if (cur->fd_table[i] == NULL)
+          {
+            success = false;
+            break;
+          }
+        file_seek (cur->fd_table[i], file_tell (parent->fd_table[i]));
+      }
+
+  return success && cur->file != NULL
+         && page_table_fork (&cur->page_table, parent);
+}
+
 /* A thread function that loads a user process and starts it
    running. */
 static void
@@ -161,8 +258,10 @@ process_exit (void)
   // palloc_free_page (thread_current()->pagedir);
   for(unsigned i = 0; i <= thread_current()->max_mapid; i++) Munmap(i);
   /*pte delete*/
-  file_close(thread_current()->file);
+  /* Destroy the page table while the executable is still open: shared
+     frames are keyed by its inode. */
   page_table_destroy(&(thread_current()->page_table));
+  file_close(thread_current()->file);
 
   pd = thread_current()->pagedir;
 
@@ -368,7 +467,6 @@ load (const char *file_name, void (**eip) (void), void **esp)
   
 
   argc = i;
-  lock_acquire(&filesys_lock);
   file = filesys_open (argv[0]);
   if (file) t->file = file;
   if (file == NULL) 
@@ -467,7 +565,6 @@ load (const char *file_name, void (**eip) (void), void **esp)
 
  done:
   /* We arrive here whether the load is successful or not. */
-  lock_release(&filesys_lock);
   return success;
 }
 
@@ -542,50 +639,22 @@ load_segment (struct file *file, off_t ofs, uint8_t *upage,
   ASSERT (pg_ofs (upage) == 0);
   ASSERT (ofs % PGSIZE == 0);
 
-  file_seek (file, ofs);
-  while (read_bytes > 0 || zero_bytes > 0) 
-    {
-      /* Calculate how to fill this page.
-         We will read PAGE_READ_BYTES bytes from FILE
-         and zero the final PAGE_ZERO_BYTES bytes. */
-      size_t page_read_bytes = read_bytes < PGSIZE ? read_bytes : PGSIZE;
-      size_t page_zero_bytes = PGSIZE - page_read_bytes;
-
-      struct PTE* pte = create_pte(upage, LOAD, writable, file, ofs, page_read_bytes, false);
-      if(pte == NULL) return false;
-      page_insert_entry(&(thread_current()->page_table), pte);
-
-      /* Advance. */
-      read_bytes -= page_read_bytes;
-      zero_bytes -= page_zero_bytes;
-      ofs += page_read_bytes;
-      upage += PGSIZE;
-    }
-  return true;
+  /* One region for the whole segment, loaded lazily page by
+     page. */
+  return page_add_region (upage, (read_bytes + zero_bytes) / PGSIZE, LOAD,
+                          writable, file, ofs, read_bytes) != NULL;
 }
 
-/* Create a minimal stack by mapping a zeroed page at the top of
-   user virtual memory. */
+/* Create a minimal stack by registering a zero page at the top of
+   user virtual memory.  Pushing the arguments faults it in. */
 static bool
 setup_stack (void **esp) 
 {
-  struct frame *f = alloc_page_to_frame(PAL_USER | PAL_ZERO);
-  if(f == NULL) return false;
-
-  bool success = false;
-  success = install_page (((uint8_t *) PHYS_BASE) - PGSIZE, f->pfn, true);
-
-  if(success){
-    *esp = PHYS_BASE;
-
-    // create a page table entry for the stack
-    f->pte = create_pte(((uint8_t *) PHYS_BASE) - PGSIZE, SWAP, true, NULL, 0, 0, true);
-    if(f->pte == NULL) return false;
-    page_insert_entry(&(thread_current()->page_table), f->pte);
-  }
-  else
-    free_frame(f->pfn);
-  return success;
+  // create a region for the stack
+  if(page_add_region(((uint8_t *) PHYS_BASE) - PGSIZE, 1, SWAP, true, NULL, 0, 0) == NULL)
+    return false;
+  *esp = PHYS_BASE;
+  return true;
 }
 
 /* Adds a mapping from user virtual address UPAGE to kernel
@@ -610,32 +679,161 @@ install_page (void *upage, void *kpage, bool writable)
           && pagedir_set_page (t->pagedir, upage, kpage, writable));
 }
 
+/* True if PTE is a writable page that holds only zeros: a BSS
+   page, or an anonymous page that was never swapped out. */
+static bool
+is_zero_page (struct PTE *pte)
+{
+  if (pte->type == LOAD)
+    return page_writable(pte) && page_read_bytes(pte) == 0;
+  return pte->type == SWAP && pte->swap_slot == 0;
+}
+
 bool
-handle_mm_fault (struct PTE *pte) {
-  struct frame *f = alloc_page_to_frame(PAL_USER);
+handle_mm_fault (struct PTE *pte, bool write) {
+  // the page may be on its way out: wait to see where it went
+  frame_wait_evicted(pte);
+
+  // reads of zero pages share the zero frame until the first store
+  if (is_zero_page(pte) && !write)
+    return map_zero_frame(pte);
+
+  // read-only executable pages are shared by every process running
+  // the same executable
+  if (pte->type == LOAD && !page_writable(pte)) {
+    if (!load_shared_frame(pte)) return false;
+    // about to be used: keep the clock off it during fault-around
+    pagedir_set_accessed(thread_current()->pagedir, pte->vpn, true);
+    fault_around(pte);
+    return true;
+  }
+
+  struct frame *f = alloc_page_to_frame(is_zero_page(pte) ? \
+    PAL_USER | PAL_ZERO : PAL_USER);
   // if(f == NULL) return false;
   f->pte = pte;
   bool success = false;
 
+  // a zero page is stored to: the frame is already zeroed
+  if (is_zero_page(pte))
+    success = install_page(pte->vpn, f->pfn, page_writable(pte));
   // simply load from the same file in the disk
-  if (pte->type == LOAD || pte->type == MEMMAP) {
+  else if (pte->type == LOAD || pte->type == MEMMAP) {
     if (load_to_frame(f->pfn, pte)) {
-      success = install_page(pte->vpn, f->pfn, pte->writable);
+      success = install_page(pte->vpn, f->pfn, page_writable(pte));
     }
+    // the faulting frame stays pinned, so fault-around cannot evict it
+    if (success) fault_around(pte);
   }
   // if from swap space, but not in the memory yet, swap in
   else if (pte->type == SWAP){
-    swap_in(pte->swap_slot, f->pfn);
-    success = install_page(pte->vpn, f->pfn, pte->writable);
+    size_t slot = pte->swap_slot;
+    swap_in(slot, f->pfn);
+    // swap_in() released the slot
+    pte->swap_slot = 0;
+    success = install_page(pte->vpn, f->pfn, page_writable(pte));
+    // the faulting frame stays pinned, so readahead cannot evict it
+    if (success) swap_readahead(pte->vpn, slot);
   }
 
   // if load fails, free the frame
-  if (success) pte->mem_flag = true;
+  if (success) {
+    pte->mem_flag = true;
+    unpin_frame(f);
+  }
   else free_frame(f->pfn);
 
   return success;
 }
 
+/* Fault-around.  After a fault on file-backed PTE, loads and maps
+   up to fault_around_pages following pages that are registered
+   from the same file and not yet in memory, so that a scan takes
+   one fault per window instead of one per page. */
+static void
+fault_around (struct PTE *pte)
+{
+  size_t i;
+
+  for (i = 1; i <= fault_around_pages; i++)
+    {
+      void *next = (uint8_t *) pte->vpn + i * PGSIZE;
+      if (!is_user_vaddr (next))
+        break;
+
+      struct PTE *p = page_lookup (next);
+      if (p == NULL || p->region != pte->region || p->type != pte->type
+          || p->mem_flag || is_zero_page (p))
+        break;
+
+      if (p->type == LOAD && !page_writable (p))
+        {
+          if (!load_shared_frame (p))
+            break;
+          continue;
+        }
+
+      struct frame *f = alloc_page_to_frame (PAL_USER);
+      if (!load_to_frame (f->pfn, p)
+          || !install_page (next, f->pfn, page_writable (p)))
+        {
+          free_frame (f->pfn);
+          break;
+        }
+      f->pte = p;
+      p->mem_flag = true;
+      unpin_frame (f);
+    }
+}
+
+/* Swap readahead.  After a swap fault on UPAGE, which was in swap
+   slot SLOT, maps the following pages of the process whose swap
+   slots follow SLOT, up to the current window.  The window doubles
+   when the fault lands right after the previous window, i.e. the
+   process is scanning sequentially, and halves otherwise, down to
+   one page. */
+static void
+swap_readahead (void *upage, size_t slot)
+{
+  struct thread *t = thread_current ();
+  size_t i;
+
+  if (upage == t->swap_ra_next)
+    {
+      t->swap_ra_window *= 2;
+      if (t->swap_ra_window > SWAP_RA_MAX)
+        t->swap_ra_window = SWAP_RA_MAX;
+    }
+  else if (t->swap_ra_window > 1)
+    t->swap_ra_window /= 2;
+
+  for (i = 1; i <= t->swap_ra_window; i++)
+    {
+      void *next = (uint8_t *) upage + i * PGSIZE;
+      if (!is_user_vaddr (next))
+        break;
+
+      // only pages evicted next to this one
+      struct PTE *p = page_lookup (next);
+      if (p == NULL || p->type != SWAP || p->mem_flag
+          || p->swap_slot != slot + i)
+        break;
+
+      struct frame *f = alloc_page_to_frame (PAL_USER);
+      swap_read (p->swap_slot, f->pfn);
+      if (!install_page (next, f->pfn, page_writable (p)))
+        {
+          free_frame (f->pfn);
+          break;
+        }
+      f->pte = p;
+      p->mem_flag = true;
+      unpin_frame (f);
+    }
+
+  t->swap_ra_next = (uint8_t *) upage + i * PGSIZE;
+}
+
 bool
 stack_growth (void *addr, void *esp) {
   // check if the address is valid
@@ -648,17 +846,13 @@ stack_growth (void *addr, void *esp) {
   // get boundary
   void *upage = pg_round_down(addr);
 
-  struct frame *f = alloc_page_to_frame(PAL_USER | PAL_ZERO);
-  if(f == NULL) return false;
-
-  bool success = install_page(upage, f->pfn, true);
-  if(success){
-    f->pte = create_pte(upage, SWAP, true, NULL, 0, 0, true);
-    if(f->pte == NULL) return false;
-    page_insert_entry(&(thread_current()->page_table), f->pte);
-  }
-  else
-    free_frame(f->pfn);
-
-  return success;
+  // register zero pages from here up to the stack in one region,
+  // the fault maps this one in
+  size_t page_cnt = 1;
+  struct vm_region *next = page_next_region(upage);
+  if(next != NULL && next->type == SWAP)
+    page_cnt = pg_no(next->start) - pg_no(upage);
+  // a large region may not fit in one allocation
+  return page_add_region(upage, page_cnt, SWAP, true, NULL, 0, 0) != NULL
+    || (page_cnt > 1 && page_add_region(upage, 1, SWAP, true, NULL, 0, 0) != NULL);
 }
\ No newline at end of file
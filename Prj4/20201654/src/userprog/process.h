@@ -2,14 +2,21 @@
 #define USERPROG_PROCESS_H
 
 #include "threads/thread.h"
+#include "threads/interrupt.h"
 #include "vm/page.h"
 
 
 // #include "vm/page.h"
+
+/* Pages mapped around a fault on a file-backed page,
+   "-fault-around=N" option. */
+extern size_t fault_around_pages;
+
 tid_t process_execute (const char *file_name);
+tid_t process_fork (struct intr_frame *parent_if);
 int process_wait (tid_t);
 void process_exit (void);
 void process_activate (void);
-bool handle_mm_fault (struct PTE *pte);
+bool handle_mm_fault (struct PTE *pte, bool write);
 bool stack_growth (void *fault_addr, void *esp);
 #endif /* userprog/process.h */
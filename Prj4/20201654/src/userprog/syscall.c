@@ -1,10 +1,12 @@
 #include "userprog/syscall.h"
 #include <stdio.h>
+#include <round.h>
 #include <syscall-nr.h>
 #include "threads/interrupt.h"
 #include "threads/thread.h"
 #include "threads/vaddr.h"
 #include "devices/shutdown.h"
+#include "devices/timer.h"
 #include "process.h"
 #include "devices/input.h"
 #include "filesys/filesys.h"
@@ -13,11 +15,9 @@
 #include "threads/malloc.h"
 
 static void syscall_handler (struct intr_frame *);
-//struct lock filesys_lock;
 
 void syscall_init (void) 
 {
-  lock_init(&filesys_lock);
   intr_register_int (0x30, 3, INTR_ON, syscall_handler, "syscall");
 }
 
@@ -57,6 +57,9 @@ syscall_handler (struct intr_frame *f UNUSED)
       check_user_vaddr(f->esp, f->esp + 4);
       f->eax = Exec((const char *)*(uint32_t *)(f->esp + 4));
       break;
+    case SYS_FORK:
+      f->eax = Fork(f);
+      break;
     case SYS_WAIT:
       check_user_vaddr(f->esp, f->esp + 4);
       f->eax = Wait(*(uint32_t *)(f->esp + 4));
@@ -109,6 +112,9 @@ syscall_handler (struct intr_frame *f UNUSED)
     case SYS_MAX_OF_FOUR_INT:
       f->eax = Max_of_four_int(*(uint32_t *)(f->esp + 4), *(uint32_t *)(f->esp + 8), *(uint32_t *)(f->esp + 12), *(uint32_t *)(f->esp + 16));
       break;
+    case SYS_TICKS:
+      f->eax = Ticks();
+      break;
     case SYS_MMAP:
       check_user_vaddr(f->esp, f->esp + 4);
       check_user_vaddr(f->esp, f->esp + 8);
@@ -155,6 +161,12 @@ int Exec(const char *cmd_line){
   return process_execute(cmd_line);
 }
 
+/// fork: clones the current process. the child shares the parent's
+/// pages copy-on-write and returns 0, the parent gets the child's pid
+int Fork(struct intr_frame *f){
+  return process_fork(f);
+}
+
 /// 4) wait: waits for a child process pid and retrieves the child's exit status
 /// return the status that was passed to exit
 int Wait (int pid){
@@ -165,11 +177,7 @@ int Wait (int pid){
 // return true if successful, false otherwise
 bool Create (const char *file, unsigned size) {
   check_user_vaddr(file - 16, file);
-  lock_acquire(&filesys_lock);
-  bool success = filesys_create(file, size);
-  //for(int i = 0; i < 12345678; i++);
-  lock_release(&filesys_lock);
-  return success;
+  return filesys_create(file, size);
 }
 
 // 6) remove: deletes the file called file
@@ -177,10 +185,7 @@ bool Create (const char *file, unsigned size) {
 bool Remove (const char *file){
   check_user_vaddr(file - 8, file);
   if(file == NULL) Exit(-1);
-  lock_acquire(&filesys_lock);
-  bool success = filesys_remove(file);
-  lock_release(&filesys_lock);
-  return success;
+  return filesys_remove(file);
 } 
 
 // 7) open: opens the file called file
@@ -189,24 +194,16 @@ int Open (const char *file) {
   check_user_vaddr(file - 8, file);
   if(file == NULL) Exit(-1);
 
-  lock_acquire(&filesys_lock);
-  for(int i = 0; i < 12345678; i++) ;
   struct file *f = filesys_open(file);
-  if(f == NULL){
-    lock_release(&filesys_lock);
-    return TID_ERROR;
-  }
-  else {
-    if(strcmp(thread_current()->name, file) == NULL) file_deny_write(f);
-    for(int i = 3; i < 128; i++){
-      if(thread_current()->fd_table[i] == NULL) {
-        thread_current()->fd_table[i] = f;
-        lock_release(&filesys_lock);
-        return i;
-      }
+  if(f == NULL) return TID_ERROR;
+  if(strcmp(thread_current()->name, file) == NULL) file_deny_write(f);
+  for(int i = 3; i < 128; i++){
+    if(thread_current()->fd_table[i] == NULL) {
+      thread_current()->fd_table[i] = f;
+      return i;
     }
   }
-  lock_release(&filesys_lock);
+  file_close(f);
   return TID_ERROR;
 }
 
@@ -214,10 +211,7 @@ int Open (const char *file) {
 int Filesize (int fd) {
   if(!is_valid_file_descrpitor(fd)) return TID_ERROR;
   if (fd == 0) return TID_ERROR;
-  lock_acquire(&filesys_lock);
-  int ret = file_length(thread_current()->fd_table[fd]);
-  lock_release(&filesys_lock);
-  return ret;
+  return file_length(thread_current()->fd_table[fd]);
 }
 
 /// 9) read: reads size bytes from the file open as fd into buffer
@@ -227,27 +221,19 @@ int Read (int fd, void *buffer, unsigned size){
   check_user_vaddr(buffer - 8, buffer);
   unsigned i;
   //fd = 0: reads from keyboard using input_getc()
-  lock_acquire(&filesys_lock);
   if (fd == 0) {
     for (i = 0; i < size; i++){
       ((uint8_t *)buffer)[i] = input_getc();
       if (((char *)buffer)[i] == '\0') break;
     }
-    lock_release(&filesys_lock);
     return i;
   }
 
   else if (fd > 2 && fd < 128){
-    if(!is_valid_file_descrpitor(fd)){
-      lock_release(&filesys_lock);
-      Exit(-1);
-    }
-    int r = file_read(thread_current()->fd_table[fd], buffer, size);
-    lock_release(&filesys_lock);
-    return r;
+    if(!is_valid_file_descrpitor(fd)) Exit(-1);
+    return file_read(thread_current()->fd_table[fd], buffer, size);
   }
 
-  lock_release(&filesys_lock);
   Exit(-1);
 }
 
@@ -255,36 +241,23 @@ int Read (int fd, void *buffer, unsigned size){
 /// return # of bytes actually written, -1 if error
 /// if fd > 3, write to file
 int Write (int fd, const void *buffer, unsigned size){
-
-  lock_acquire(&filesys_lock);
   check_user_vaddr(buffer - 8, buffer);
 
-  //fd = 1: writes to the console
+  //fd = 1: writes to the console, which has its own lock
   if (fd == 1) {
     putbuf(buffer, size);
-    lock_release(&filesys_lock);
     return size;
   }
   else if (fd > 2 && fd < 128){
-    if(!is_valid_file_descrpitor(fd)){
-      lock_release(&filesys_lock);
-      Exit(-1);
-    }
-    int r = file_write(thread_current()->fd_table[fd], buffer, size);
-    lock_release(&filesys_lock);
-    return r;
-  }
-  else {
-    lock_release(&filesys_lock);
-    Exit(-1);
+    if(!is_valid_file_descrpitor(fd)) Exit(-1);
+    return file_write(thread_current()->fd_table[fd], buffer, size);
   }
+  else Exit(-1);
 }
 // 11) seek: changes the next byte to be read or written in open file fd to position
 void Seek (int fd, unsigned pos) {
   if (!is_valid_file_descrpitor(fd)) Exit(-1);
-  lock_acquire(&filesys_lock);
   file_seek(thread_current()->fd_table[fd], pos);
-  lock_release(&filesys_lock);
 }
 
 // 12) tell: returns the position of the next byte to be read or written in open file fd
@@ -325,48 +298,48 @@ int Max_of_four_int(int a, int b, int c, int d) {
   return M;
 }
 
+// ticks: returns the number of timer ticks since boot, for timing
+// from user programs
+int Ticks(void) {
+  return (int) timer_ticks();
+}
+
 // Load file data into memory by demand paging
 
 int Mmap(int fd, void *addr) {
-  if (addr == NULL || pg_ofs(addr) != 0 || page_lookup(addr)) return -1;
+  if (addr == NULL || pg_ofs(addr) != 0) return -1;
   if (fd < 3 || fd >= 128 || thread_current()->fd_table[fd] == NULL) return -1;
   struct mmap_file *mmap_file = malloc(sizeof(struct mmap_file));
   if (mmap_file == NULL) return -1;
 
-  list_init(&mmap_file->pte_list);
-  list_push_back(&thread_current()->mmap_list, &mmap_file->elem);
-  mmap_file->mapid = thread_current()->max_mapid;
-  thread_current()->max_mapid += 1;
-
-  lock_acquire(&filesys_lock);
   mmap_file->file = file_reopen(thread_current()->fd_table[fd]);
-  lock_release(&filesys_lock);
+  if (mmap_file->file == NULL) {
+    free(mmap_file);
+    return -1;
+  }
 
   //file size = 0 -> return -1
   off_t file_size = file_length(mmap_file->file);
   if (file_size == 0) {
-    // free(mmap_file);
+    file_close(mmap_file->file);
+    free(mmap_file);
     return -1;
   }
-;
-  
-  
-  off_t offset = 0;
-  // read the file into memory
-  while (file_size > 0) {
-    size_t read_bytes = file_size < PGSIZE ? file_size : PGSIZE;
-    struct PTE *pte = create_pte(addr, MEMMAP, true, mmap_file->file, offset,\
-                      read_bytes, false);
-    if (pte == NULL) return 0;
-    page_insert_entry(&thread_current()->page_table, pte);
-    list_push_back(&mmap_file->pte_list, &pte->mmap_elem);
-
-    // update variables
-    file_size -= PGSIZE;
-    offset += PGSIZE;
-    addr += PGSIZE;
+
+  // one region for the whole file, loaded by demand paging. fails if
+  // it overlaps any other page of the process
+  mmap_file->region = page_add_region(addr, DIV_ROUND_UP(file_size, PGSIZE), \
+    MEMMAP, true, mmap_file->file, 0, file_size);
+  if (mmap_file->region == NULL) {
+    file_close(mmap_file->file);
+    free(mmap_file);
+    return -1;
   }
 
+  list_push_back(&thread_current()->mmap_list, &mmap_file->elem);
+  mmap_file->mapid = thread_current()->max_mapid;
+  thread_current()->max_mapid += 1;
+
   return mmap_file->mapid;
 }
 void Munmap(unsigned mapid) {
@@ -374,28 +347,26 @@ void Munmap(unsigned mapid) {
   struct list_elem *e;
   //find the mmap_file with the given mapid
   for (e = list_begin(&thread_current()->mmap_list); e != list_end(&thread_current()->mmap_list); e = list_next(e)) {
-    mmap_file = list_entry(e, struct mmap_file, elem);
-    if (mmap_file->mapid == mapid) break;
+    struct mmap_file *m = list_entry(e, struct mmap_file, elem);
+    if (m->mapid == mapid) {
+      mmap_file = m;
+      break;
+    }
   }
   if (mmap_file == NULL) return;
 
-  struct list_elem *e2;
-  for (e2 = list_begin(&mmap_file->pte_list); e2 != list_end(&mmap_file->pte_list);) {
-    struct PTE *pte = list_entry(e2, struct PTE, mmap_elem);
+  // write the dirty pages back to the file
+  struct vm_region *r = mmap_file->region;
+  for (size_t i = 0; i < r->page_cnt; i++) {
+    struct PTE *pte = &r->pages[i];
     if (pte->mem_flag && pagedir_is_dirty(thread_current()->pagedir, pte->vpn)) {
-      lock_acquire(&filesys_lock);
-      size_t read_byte = pte->read_bytes;
-      if ((size_t)file_write_at(pte->file, pte->vpn, pte->read_bytes, pte->offset) != read_byte) {
+      size_t read_byte = page_read_bytes(pte);
+      if ((size_t)file_write_at(page_file(pte), pte->vpn, read_byte, page_offset(pte)) != read_byte) {
         NOT_REACHED();
       }
-      lock_release(&filesys_lock);
-      free_frame(pagedir_get_page(thread_current()->pagedir, pte->vpn));
     }
-
-    pte->mem_flag = false;
-    e2 = list_remove(e2);
-    page_delete_entry(&thread_current()->page_table, pte);
   }
+  page_remove_region(r);
   list_remove(&mmap_file->elem);
   free(mmap_file);
 
@@ -3,12 +3,12 @@
 #ifndef USERPROG_SYSCALL_H
 #define USERPROG_SYSCALL_H
 typedef unsigned mapid_t;
-struct lock filesys_lock;
 void syscall_init (void);
 void check_user_vaddr(const void *esp, const void *vaddr);
 void Halt (void);
 void Exit (int status);
 int Exec (const char *cmd_line);
+int Fork (struct intr_frame *f);
 int Wait (int pid);
 bool Create (const char *file, unsigned initial_size);
 bool Remove (const char *file);
@@ -21,6 +21,7 @@ unsigned Tell (int fd);
 void Close (int fd);
 int Fibonacci (int n);
 int Max_of_four_int (int a, int b, int c, int d);
+int Ticks (void);
 int Mmap (int fd, void *addr);
 void Munmap (mapid_t mapping);
 
@@ -1,69 +1,213 @@
+#include <stdio.h>
 #include "vm/frame.h"
 #include "vm/swap.h"
 #include "threads/malloc.h"
+#include "threads/vaddr.h"
 #include "lib/string.h"
 
-#define PGSIZE 4096
-// frame table list
-struct list frame_table;
-// for iterating through the frame table
-struct list_elem *frame_ptr;
+// frame descriptor table, one entry per page of the user pool,
+// indexed by physical page number relative to the pool base
+static struct frame *frame_table;
+// number of entries in frame_table
+static size_t frame_cnt;
+// first page of the user pool
+static void *frame_base;
+// two-handed clock: the front hand clears the accessed bit, and
+// the back hand, frame_hand_spread entries behind, evicts frames
+// that were not accessed again in between
+static size_t front_hand;
+// distance between the hands (-spread=N, 0 means a quarter of the table)
+size_t frame_hand_spread;
+// page of zeros, mapped read-only for pages that were never written.
+// it comes from the kernel pool, so it is never evicted or freed.
+static void *zero_frame;
 // lock for frame table for synch
 struct lock frame_lock;
+// signalled when a frame finishes background writeback
+static struct condition writeback_done;
+
+// number of clean, evictable frames the page cleaner tries to keep
+// between the two clock hands
+#define CLEANER_LOW_WATERMARK 32
+// number of anonymous frames the page cleaner writes per swap cluster
+#define CLEANER_BATCH 8
+// wakes the page cleaner
+static struct semaphore cleaner_sema;
+// true if the page cleaner has been woken but has not run yet
+static bool cleaner_pending;
+// frame the page cleaner starts from: the back hand, or a dirty
+// frame the back hand skipped
+static size_t cleaner_hand;
+
+/* A frame mapped by several processes: either a read-only
+   executable page shared by every process that maps the same
+   (inode, offset), or a copy-on-write page shared by a forked
+   process and its parent. */
+struct shared_frame{
+    struct inode *inode; // Executable the page comes from, NULL if copy-on-write
+    size_t offset; // Offset of the page in the executable
+    struct frame *frame; // Frame that holds the page
+    struct list maps; // struct frame_mapping, one per process
+    struct hash_elem elem; // Hash element for shared_frames
+};
+
+/* One process's mapping of a shared frame. */
+struct frame_mapping{
+    struct thread *t; // Mapping process
+    struct PTE *pte; // Its page table entry
+    struct list_elem elem; // List element for shared_frame's maps
+};
+
+// shared frames, keyed by (inode, offset)
+static struct hash shared_frames;
 
 struct frame *alloc_page_to_frame(enum palloc_flags fg);
 struct frame *find_frame(void *pfn);
+static size_t frame_index(void *pfn);
 static void delete_frame(struct frame *f);
 void free_frame(void *pfn);
 bool load_to_frame(void *pfn, struct PTE *pte);
-void evict_frame(void);
-static struct list_elem *clock(void);
+bool evict_frame(void);
+static struct frame *clock(void);
+static size_t back_hand(void);
+static size_t clean_ahead(void);
+static void wake_cleaner(size_t from);
+static bool evicting(struct thread *t, struct PTE *pte);
+static void page_cleaner(void *aux);
+static void clean_frames(void);
+static bool writeback_mmap(struct frame *f);
+static size_t writeback_swap(struct frame **batch, size_t cnt);
+static bool frame_accessed(struct frame *f);
+static void frame_clear_accessed(struct frame *f);
+static void unmap_shared(struct frame *f);
+static void drop_mapping(struct frame *f, struct thread *t);
+static bool share_cow(struct frame *f, struct thread *parent, \
+    struct PTE *ppte, struct PTE *cpte);
+
+/* Statistics. */
+static long long frame_lookup_cnt; /* # of find_frame() calls. */
+static long long frame_free_cnt;   /* # of frames released. */
+static long long frame_evict_cnt;  /* # of frames evicted. */
+static long long frame_scan_cnt;   /* # of frames examined by the back hand. */
+static long long frame_dirty_evict_cnt; /* # of evictions that wrote to disk. */
+static long long frame_clean_cnt;  /* # of frames written by the page cleaner. */
+static long long frame_share_cnt;  /* # of faults served by a shared frame. */
+static long long frame_cow_cnt;    /* # of pages copied on write. */
+static long long frame_zero_cnt;   /* # of faults served by the zero frame. */
+
+/* Returns a hash value for shared frame s. */
+static unsigned shared_hash(const struct hash_elem *s_, void *aux UNUSED){
+    const struct shared_frame *s = hash_entry(s_, struct shared_frame, elem);
+    return hash_bytes(&s->inode, sizeof s->inode) ^ hash_int(s->offset);
+}
 
+/* Returns true if shared frame a precedes shared frame b. */
+static bool shared_less(const struct hash_elem *a_, const struct hash_elem *b_, \
+    void *aux UNUSED){
+    const struct shared_frame *a = hash_entry(a_, struct shared_frame, elem);
+    const struct shared_frame *b = hash_entry(b_, struct shared_frame, elem);
+    if(a->inode != b->inode) return a->inode < b->inode;
+    return a->offset < b->offset;
+}
 
 void frame_table_init(void){
-    frame_ptr = NULL;
-    list_init(&frame_table);
     lock_init(&frame_lock);
+    cond_init(&writeback_done);
+    sema_init(&cleaner_sema, 0);
+    cleaner_pending = false;
+    hash_init(&shared_frames, shared_hash, shared_less, NULL);
+
+    zero_frame = palloc_get_page(PAL_ZERO);
+    if(zero_frame == NULL)
+        PANIC("frame_table_init: cannot allocate zero frame");
+
+    frame_cnt = palloc_user_pages(&frame_base);
+    frame_table = calloc(frame_cnt, sizeof *frame_table);
+    if(frame_table == NULL)
+        PANIC("frame_table_init: cannot allocate frame table");
+
+    // keep the spread within the table
+    if(frame_hand_spread == 0 || frame_hand_spread >= frame_cnt)
+        frame_hand_spread = frame_cnt / 4;
+    if(frame_hand_spread == 0)
+        frame_hand_spread = 1;
+    front_hand = 0;
 }
 
-struct frame *alloc_page_to_frame(enum palloc_flags fg){
-    struct frame *f = (struct frame *)malloc(sizeof(struct frame));
-    if(f == NULL) return NULL;
+// Starts the page cleaner. Must be called once the swap device
+// and the file system are available.
+void frame_cleaner_init(void){
+    thread_create("cleaner", PRI_DEFAULT, page_cleaner, NULL);
+}
 
-    // initialize frame
-    memset(f, 0, sizeof(struct frame));
-    f->t = thread_current();
-    f->pfn = palloc_get_page(fg);
+// Prints frame table statistics.
+void frame_print_stats(void){
+    printf("Frame: %lld lookups, %lld frees, %lld evictions "
+        "(%lld dirty), %lld frames scanned, %lld cleaned, %lld shared, "
+        "%lld copied on write, %lld zero-mapped\n",
+        frame_lookup_cnt, frame_free_cnt, frame_evict_cnt,
+        frame_dirty_evict_cnt, frame_scan_cnt, frame_clean_cnt,
+        frame_share_cnt, frame_cow_cnt, frame_zero_cnt);
+}
+
+// index of the user pool page PFN in frame_table
+static size_t frame_index(void *pfn){
+    size_t idx = pg_no(pfn) - pg_no(frame_base);
+    ASSERT(idx < frame_cnt);
+    return idx;
+}
 
-    // add to frame table
-    while (f->pfn == NULL){
+// allocate a user page and its frame descriptor, evicting if needed.
+// the frame is returned pinned; call unpin_frame() once it is mapped.
+struct frame *alloc_page_to_frame(enum palloc_flags fg){
+    ASSERT(fg & PAL_USER);
+    void *pfn = palloc_get_page(fg);
+
+    while (pfn == NULL){
         lock_acquire(&frame_lock);
-        evict_frame();
+        // drops frame_lock while the victim is written
+        bool evicted = evict_frame();
         lock_release(&frame_lock);
-        f->pfn = palloc_get_page(fg);
+        // every frame is pinned: let their owners finish
+        if(!evicted) thread_yield();
+        pfn = palloc_get_page(fg);
     }
 
+    // initialize frame
     lock_acquire(&frame_lock);
-    list_push_back(&frame_table, &f->elem);
+    struct frame *f = &frame_table[frame_index(pfn)];
+    f->pfn = pfn;
+    f->t = thread_current();
+    f->pte = NULL;
+    f->in_use = true;
+    f->pinned = true;
+    f->writeback = false;
+    f->share = NULL;
     lock_release(&frame_lock);
 
     return f;
 }
 
-struct frame *find_frame(void *pfn){
-    struct list_elem *e;
-    struct frame *f;
-    for(e = list_begin(&frame_table); e != list_end(&frame_table); e = list_next(e)){
-        f = list_entry(e, struct frame, elem);
-        if(f->pfn == pfn) return f;
-    }
+// let the clock consider F for eviction
+void unpin_frame(struct frame *f){
+    lock_acquire(&frame_lock);
+    f->pinned = false;
+    lock_release(&frame_lock);
+}
 
-    return NULL;
+// find the frame that holds the physical page PFN in O(1)
+struct frame *find_frame(void *pfn){
+    frame_lookup_cnt++;
+    if(pfn == NULL || pfn == zero_frame) return NULL;
+    struct frame *f = &frame_table[frame_index(pfn)];
+    return f->in_use ? f : NULL;
 }
 static void delete_frame (struct frame *f){
-    struct list_elem *e = &(f->elem);
-    struct list_elem *rm = list_remove(e);
-    if (e == frame_ptr) frame_ptr = rm;
+    ASSERT(f->share == NULL);
+    f->in_use = false;
+    f->pinned = false;
+    f->pte = NULL;
+    f->t = NULL;
 }
 
 void free_frame(void *pfn){
@@ -73,16 +217,35 @@ void free_frame(void *pfn){
         lock_release(&frame_lock);
         return;
     }
+    // the page cleaner still reads this frame and its PTE
+    while(f->writeback)
+        cond_wait(&writeback_done, &frame_lock);
+    // a shared frame outlives all but its last mapping
+    if(f->share != NULL){
+        struct shared_frame *sf = f->share;
+        drop_mapping(f, thread_current());
+        if(!list_empty(&sf->maps)){
+            lock_release(&frame_lock);
+            return;
+        }
+        if(sf->inode != NULL)
+            hash_delete(&shared_frames, &sf->elem);
+        free(sf);
+        f->share = NULL;
+        f->pte = NULL;
+    }
+    if(f->pte != NULL)
+        pagedir_clear_page(f->t->pagedir, f->pte->vpn);
     delete_frame(f);
-    pagedir_clear_page(f->t->pagedir, f->pte->vpn);
-    palloc_free_page(f->pfn);
-    free(f);
+    palloc_free_page(pfn);
+    frame_free_cnt++;
     lock_release(&frame_lock);
 }
 
 bool load_to_frame(void *pfn, struct PTE *pte){
-    size_t read_bytes = pte->read_bytes;
-    if((size_t)file_read_at(pte->file, pfn, read_bytes, pte->offset) != read_bytes){
+    size_t read_bytes = page_read_bytes(pte);
+    if((size_t)file_read_at(page_file(pte), pfn, read_bytes, page_offset(pte)) \
+        != read_bytes){
         return false;
     }
 
@@ -90,66 +253,616 @@ bool load_to_frame(void *pfn, struct PTE *pte){
     return true;
 }
 
-// clock algorithm
-// Cycle the frame table and find the frame to evict
-static struct list_elem *clock(void){
-    // if the frame pointer is NULL and the frame table is not empty, set the frame pointer to the beginning
-    if(frame_ptr == NULL && !list_empty(&frame_table)){
-        frame_ptr = list_begin(&frame_table);
-        return frame_ptr;
+// Maps the read-only executable page PTE into the current process.
+// Reuses the frame of another process that maps the same (inode,
+// offset), or loads the page into a new shared frame. Returns false
+// if the page cannot be loaded or mapped.
+bool load_shared_frame(struct PTE *pte){
+    struct thread *cur = thread_current();
+    struct shared_frame key;
+    struct hash_elem *e;
+
+    ASSERT(pte->type == LOAD && !page_writable(pte));
+    key.inode = file_get_inode(page_file(pte));
+    key.offset = page_offset(pte);
+
+    struct frame_mapping *m = malloc(sizeof *m);
+    if(m == NULL) return false;
+    m->t = cur;
+    m->pte = pte;
+
+    lock_acquire(&frame_lock);
+    e = hash_find(&shared_frames, &key.elem);
+    if(e == NULL){
+        // not in memory: load it into a new frame
+        lock_release(&frame_lock);
+        struct frame *f = alloc_page_to_frame(PAL_USER);
+        struct shared_frame *sf = malloc(sizeof *sf);
+        if(sf == NULL || !load_to_frame(f->pfn, pte)){
+            free(sf);
+            free(m);
+            free_frame(f->pfn);
+            return false;
+        }
+        lock_acquire(&frame_lock);
+        // another process may have loaded the page meanwhile
+        e = hash_find(&shared_frames, &key.elem);
+        if(e == NULL){
+            sf->inode = key.inode;
+            sf->offset = key.offset;
+            sf->frame = f;
+            list_init(&sf->maps);
+            hash_insert(&shared_frames, &sf->elem);
+            f->share = sf;
+            f->t = cur;
+            f->pte = pte;
+            e = &sf->elem;
+        }
+        else {
+            lock_release(&frame_lock);
+            free(sf);
+            free_frame(f->pfn);
+            lock_acquire(&frame_lock);
+            // evicted while unlocked: give up, the process faults again
+            e = hash_find(&shared_frames, &key.elem);
+            if(e == NULL){
+                lock_release(&frame_lock);
+                free(m);
+                return false;
+            }
+            frame_share_cnt++;
+        }
+    }
+    else
+        frame_share_cnt++;
+
+    struct shared_frame *sf = hash_entry(e, struct shared_frame, elem);
+    struct frame *f = sf->frame;
+    bool success = pagedir_get_page(cur->pagedir, pte->vpn) == NULL \
+        && pagedir_set_page(cur->pagedir, pte->vpn, f->pfn, false);
+    if(success){
+        list_push_back(&sf->maps, &m->elem);
+        pte->mem_flag = true;
+    }
+    else
+        free(m);
+    // a new shared frame was pinned by alloc_page_to_frame()
+    if(list_empty(&sf->maps)){
+        hash_delete(&shared_frames, &sf->elem);
+        free(sf);
+        f->share = NULL;
+        f->pte = NULL;
+        lock_release(&frame_lock);
+        free_frame(f->pfn);
+        return false;
+    }
+    f->pinned = false;
+    lock_release(&frame_lock);
+    return success;
+}
+
+// Removes T's mapping of shared frame F and clears it from T's page
+// directory. keeps F's t and pte pointing at a live mapping, if any.
+static void drop_mapping(struct frame *f, struct thread *t){
+    struct shared_frame *sf = f->share;
+    struct list_elem *e;
+    for(e = list_begin(&sf->maps); e != list_end(&sf->maps); e = list_next(e)){
+        struct frame_mapping *m = list_entry(e, struct frame_mapping, elem);
+        if(m->t == t){
+            pagedir_clear_page(m->t->pagedir, m->pte->vpn);
+            list_remove(e);
+            free(m);
+            break;
+        }
     }
-    // if the frame pointer is at the end of the frame table, set it to the beginning
-    if(frame_ptr == list_end(&frame_table) && !list_empty(&frame_table)){
-        frame_ptr = list_begin(&frame_table);
-        return frame_ptr;
+    if(!list_empty(&sf->maps)){
+        struct frame_mapping *m = list_entry(list_front(&sf->maps), \
+            struct frame_mapping, elem);
+        f->t = m->t;
+        f->pte = m->pte;
     }
-    // if the frame pointer is at the end of the frame table, set it to the beginning
-    frame_ptr = list_next(frame_ptr);
-    if(frame_ptr == list_end(&frame_table)) 
-        frame_ptr = clock();
-    
-    return frame_ptr;
 }
 
-// evict frame using clock algorithm
-void evict_frame (void){
+// Gives the current process, a child being forked from PARENT, the
+// page of PARENT's entry PPTE through its own entry CPTE. A page in
+// memory is mapped read-only into both processes and copied on the
+// first write; a page in swap is copied to a new slot; a page that
+// is in neither is loaded again from the executable. Returns false
+// if memory runs out.
+bool fork_frame(struct thread *parent, struct PTE *ppte, struct PTE *cpte){
     struct frame *f;
-    // get victim frame
-    while (true){
-        f = list_entry(clock(), struct frame, elem);
-        // if the frame is accessed, set the accessed bit to false
-        if(pagedir_is_accessed(f->t->pagedir, f->pte->vpn)){
-            pagedir_set_accessed(f->t->pagedir, f->pte->vpn, 0);
+
+    lock_acquire(&frame_lock);
+    for(;;){
+        f = find_frame(pagedir_get_page(parent->pagedir, ppte->vpn));
+        if(f == NULL ? !evicting(parent, ppte) : !f->writeback) break;
+        // the frame may be evicted after the write, so look again
+        cond_wait(&writeback_done, &frame_lock);
+    }
+    // an eviction may have changed the type since the table was copied
+    cpte->type = ppte->type;
+    if(f != NULL){
+        bool success = share_cow(f, parent, ppte, cpte);
+        lock_release(&frame_lock);
+        return success;
+    }
+    // the parent waits for us, so nothing faults this page back in
+    size_t slot = ppte->swap_slot;
+    lock_release(&frame_lock);
+
+    if(slot == 0) return true;
+    cpte->swap_slot = swap_copy(slot);
+    return cpte->swap_slot != 0;
+}
+
+// Maps frame F, which PARENT maps through PPTE, read-only into the
+// current process through CPTE. A private frame becomes a
+// copy-on-write frame, and PARENT's mapping becomes read-only too.
+// Must be called with frame_lock held.
+static bool share_cow(struct frame *f, struct thread *parent, \
+    struct PTE *ppte, struct PTE *cpte){
+    struct thread *cur = thread_current();
+    struct frame_mapping *m = malloc(sizeof *m);
+    if(m == NULL) return false;
+
+    if(f->share == NULL){
+        struct shared_frame *sf = malloc(sizeof *sf);
+        struct frame_mapping *pm = malloc(sizeof *pm);
+        if(sf == NULL || pm == NULL){
+            free(sf);
+            free(pm);
+            free(m);
+            return false;
         }
-        // if the frame is not accessed, evict the frame
-        else {
-            bool dirty = pagedir_is_dirty(f->t->pagedir, f->pte->vpn);
-            // if the frame is dirty
-            if(f->pte->type == MEMMAP && dirty){
-                // if the frame is memmaped and dirty, then write 
-                // data to the file, and evict
-                file_write_at (f->pte->file, f->pfn, f->pte->read_bytes, \
-                    f->pte->offset);
+        // copy-on-write frames are not in shared_frames
+        sf->inode = NULL;
+        sf->offset = 0;
+        sf->frame = f;
+        list_init(&sf->maps);
+        pm->t = parent;
+        pm->pte = ppte;
+        list_push_back(&sf->maps, &pm->elem);
+        f->share = sf;
+        pagedir_set_writable(parent->pagedir, ppte->vpn, false);
+    }
+
+    if(!pagedir_set_page(cur->pagedir, cpte->vpn, f->pfn, false)){
+        free(m);
+        return false;
+    }
+    m->t = cur;
+    m->pte = cpte;
+    list_push_back(&f->share->maps, &m->elem);
+    cpte->mem_flag = true;
+    return true;
+}
+
+// Handles a write fault on PTE, a writable page that the current
+// process maps read-only because it is shared copy-on-write or
+// mapped to the zero frame. The last process to write takes a
+// shared frame over; the others get a private copy. Returns false
+// if PTE is neither.
+bool cow_fault(struct PTE *pte){
+    struct thread *cur = thread_current();
+    struct frame *copy = NULL;
+    bool success = true;
+
+    for(;;){
+        lock_acquire(&frame_lock);
+        void *pfn = pagedir_get_page(cur->pagedir, pte->vpn);
+        struct frame *f = find_frame(pfn);
+        // a page that was only read so far needs a zeroed frame
+        if(pfn != zero_frame){
+            // evicted meanwhile: the retried write faults the page in
+            if(f == NULL)
+                break;
+            if(f->share == NULL || f->share->inode != NULL){
+                success = false;
+                break;
+            }
+
+            struct shared_frame *sf = f->share;
+            if(list_size(&sf->maps) == 1){
+                // the only mapping left: no need to copy
+                free(list_entry(list_pop_front(&sf->maps), \
+                    struct frame_mapping, elem));
+                free(sf);
+                f->share = NULL;
+                f->t = cur;
+                f->pte = pte;
+                pagedir_set_writable(cur->pagedir, pte->vpn, true);
+                break;
             }
-            // if the frame is from the swap slot, swap out.
-            else if(f->pte->type == SWAP){
-                f->pte->swap_slot = swap_out(f->pfn);
+        }
+        if(copy != NULL){
+            if(pfn == zero_frame)
+                pagedir_clear_page(cur->pagedir, pte->vpn);
+            else {
+                memcpy(copy->pfn, f->pfn, PGSIZE);
+                drop_mapping(f, cur);
+                frame_cow_cnt++;
             }
-            // swap out and change the type to SWAP
-            else if(f->pte->type == LOAD && dirty){
-                f->pte->swap_slot = swap_out(f->pfn);
-                f->pte->type = SWAP;
+            success = pagedir_set_page(cur->pagedir, pte->vpn, copy->pfn, true);
+            if(success){
+                copy->pte = pte;
+                copy->pinned = false;
+                copy = NULL;
             }
-            
-            // free the frame
-            f->pte->mem_flag = false;
-            delete_frame(f);
-            pagedir_clear_page(f->t->pagedir, f->pte->vpn);
-            palloc_free_page(f->pfn);
-            free(f);
+            break;
+        }
+        // allocating may evict, so drop the lock and look again
+        lock_release(&frame_lock);
+        copy = alloc_page_to_frame(pfn == zero_frame ? PAL_USER | PAL_ZERO \
+            : PAL_USER);
+    }
+    lock_release(&frame_lock);
 
-            return;
+    if(copy != NULL)
+        free_frame(copy->pfn);
+    return success;
+}
+
+// true if F is shared copy-on-write
+static bool frame_is_cow(struct frame *f){
+    return f->share != NULL && f->share->inode == NULL;
+}
+
+// Maps the zero frame read-only at PTE, a page that holds only zeros
+// so far. The first store faults into cow_fault(). Returns false if
+// the page cannot be mapped.
+bool map_zero_frame(struct PTE *pte){
+    struct thread *cur = thread_current();
+    if(pagedir_get_page(cur->pagedir, pte->vpn) != NULL \
+        || !pagedir_set_page(cur->pagedir, pte->vpn, zero_frame, false))
+        return false;
+    pte->mem_flag = true;
+    frame_zero_cnt++;
+    return true;
+}
+
+// true if any process accessed F since the last clear
+static bool frame_accessed(struct frame *f){
+    if(f->share == NULL)
+        return pagedir_is_accessed(f->t->pagedir, f->pte->vpn);
+
+    struct list_elem *e;
+    for(e = list_begin(&f->share->maps); e != list_end(&f->share->maps); \
+        e = list_next(e)){
+        struct frame_mapping *m = list_entry(e, struct frame_mapping, elem);
+        if(pagedir_is_accessed(m->t->pagedir, m->pte->vpn)) return true;
+    }
+    return false;
+}
+
+// clear the accessed bit of every mapping of F
+static void frame_clear_accessed(struct frame *f){
+    if(f->share == NULL){
+        pagedir_set_accessed(f->t->pagedir, f->pte->vpn, false);
+        return;
+    }
+
+    struct list_elem *e;
+    for(e = list_begin(&f->share->maps); e != list_end(&f->share->maps); \
+        e = list_next(e)){
+        struct frame_mapping *m = list_entry(e, struct frame_mapping, elem);
+        pagedir_set_accessed(m->t->pagedir, m->pte->vpn, false);
+    }
+}
+
+// unmap shared frame F from every process and forget it. executable
+// pages are read-only and never need to be written; a copy-on-write
+// page is written to swap once for each process that maps it, without
+// holding frame_lock. Must be called with frame_lock held.
+static void unmap_shared(struct frame *f){
+    struct shared_frame *sf = f->share;
+    struct list_elem *e;
+
+    // unmap first: a process that touches the page waits in
+    // frame_wait_evicted() until its copy is written
+    for(e = list_begin(&sf->maps); e != list_end(&sf->maps); e = list_next(e)){
+        struct frame_mapping *m = list_entry(e, struct frame_mapping, elem);
+        pagedir_clear_page(m->t->pagedir, m->pte->vpn);
+    }
+    if(sf->inode == NULL){
+        // nothing changes the mappings of an unmapped, claimed frame
+        f->writeback = true;
+        lock_release(&frame_lock);
+        for(e = list_begin(&sf->maps); e != list_end(&sf->maps); \
+            e = list_next(e)){
+            struct frame_mapping *m = list_entry(e, struct frame_mapping, elem);
+            swap_free(m->pte->swap_slot);
+            m->pte->swap_slot = swap_out(f->pfn);
+            m->pte->type = SWAP;
+        }
+        lock_acquire(&frame_lock);
+        f->writeback = false;
+    }
+
+    while(!list_empty(&sf->maps)){
+        struct frame_mapping *m = list_entry(list_pop_front(&sf->maps), \
+            struct frame_mapping, elem);
+        m->pte->mem_flag = false;
+        free(m);
+    }
+    if(sf->inode != NULL)
+        hash_delete(&shared_frames, &sf->elem);
+    free(sf);
+    f->share = NULL;
+}
+
+// true if the clock may look at F
+static bool evictable(struct frame *f){
+    return f->in_use && !f->pinned && !f->writeback && f->pte != NULL;
+}
+
+// true if the page of PTE, which T maps, is being evicted: eviction
+// unmaps the page before writing it and clears mem_flag afterwards.
+// Must be called with frame_lock held.
+static bool evicting(struct thread *t, struct PTE *pte){
+    return pte->mem_flag && pagedir_get_page(t->pagedir, pte->vpn) == NULL;
+}
+
+// Waits until the eviction of the current process's page PTE, if
+// any, has finished, so that a fault on it sees where it went.
+void frame_wait_evicted(struct PTE *pte){
+    lock_acquire(&frame_lock);
+    while(evicting(thread_current(), pte))
+        cond_wait(&writeback_done, &frame_lock);
+    lock_release(&frame_lock);
+}
+
+// true if evicting F would not need a disk write
+static bool frame_is_clean(struct frame *f){
+    // shared executable pages are read-only, copy-on-write pages
+    // need one copy per process
+    if(f->share != NULL) return !frame_is_cow(f);
+    if(pagedir_is_dirty(f->t->pagedir, f->pte->vpn)) return false;
+    // SWAP pages are clean only if swap already holds a copy
+    return f->pte->type != SWAP || f->pte->swap_slot != 0;
+}
+
+// index of the back hand, frame_hand_spread entries behind the front
+static size_t back_hand(void){
+    return (front_hand + frame_cnt - frame_hand_spread) % frame_cnt;
+}
+
+// Counts the clean, unaccessed frames the back hand reaches before
+// the front hand, stopping at CLEANER_LOW_WATERMARK.
+static size_t clean_ahead(void){
+    size_t back = back_hand();
+    size_t clean = 0;
+    size_t i;
+
+    for(i = 0; i < frame_hand_spread && clean < CLEANER_LOW_WATERMARK; i++){
+        struct frame *f = &frame_table[(back + i) % frame_cnt];
+        if(evictable(f) && !frame_accessed(f) && frame_is_clean(f))
+            clean++;
+    }
+    return clean;
+}
+
+// Wakes the page cleaner to clean from frame FROM up to the front
+// hand, unless it is already about to run.
+static void wake_cleaner(size_t from){
+    if(cleaner_pending) return;
+    cleaner_pending = true;
+    cleaner_hand = from;
+    sema_up(&cleaner_sema);
+}
+
+// two-handed clock algorithm
+// Advance both hands until the back hand finds a frame that was not
+// accessed since the front hand passed it. Dirty frames are left to
+// the page cleaner while the back hand looks on for a clean one; the
+// first of them is returned if CLEANER_LOW_WATERMARK are skipped or
+// the sweep ends. Returns NULL if every frame is pinned.
+static struct frame *clock(void){
+    struct frame *dirty = NULL;
+    size_t skipped = 0;
+    // two full sweeps of the front hand are enough to clear every
+    // accessed bit and bring the back hand over all of them
+    size_t steps;
+    for(steps = 0; steps < 2 * frame_cnt + frame_hand_spread; steps++){
+        size_t back_idx = back_hand();
+        struct frame *front = &frame_table[front_hand];
+        struct frame *back = &frame_table[back_idx];
+        front_hand = (front_hand + 1) % frame_cnt;
+
+        // front hand: clear the accessed bit
+        if(evictable(front))
+            frame_clear_accessed(front);
+
+        // back hand: evict if still not accessed
+        if(evictable(back)){
+            frame_scan_cnt++;
+            if(frame_accessed(back))
+                continue;
+            if(frame_is_clean(back))
+                return back;
+            // the page cleaner does not write copy-on-write frames
+            if(!frame_is_cow(back))
+                wake_cleaner(back_idx);
+            if(dirty == NULL)
+                dirty = back;
+            if(++skipped == CLEANER_LOW_WATERMARK)
+                break;
         }
     }
+    return dirty;
+}
 
-}
\ No newline at end of file
+// evict frame using clock algorithm
+// The victim is chosen and claimed under frame_lock, which is
+// released while it is written to swap or to its file, so that
+// other faults do not wait for the disk. Must be called with
+// frame_lock held. Returns false if no frame could be evicted.
+bool evict_frame (void){
+    // keep the cleaner ahead of the back hand
+    if(!cleaner_pending && clean_ahead() < CLEANER_LOW_WATERMARK)
+        wake_cleaner(back_hand());
+
+    struct frame *f = clock();
+    if(f == NULL) return false;
+
+    if(f->share != NULL){
+        if(frame_is_cow(f)) frame_dirty_evict_cnt++;
+        unmap_shared(f);
+        palloc_free_page(f->pfn);
+        delete_frame(f);
+        frame_evict_cnt++;
+        cond_broadcast(&writeback_done, &frame_lock);
+        return true;
+    }
+
+    struct PTE *pte = f->pte;
+    if(!frame_is_clean(f)) frame_dirty_evict_cnt++;
+    // unmap before copying, so that a store made during the write
+    // faults and waits in frame_wait_evicted() instead of being lost.
+    // the dirty bit survives the unmapping
+    pagedir_clear_page(f->t->pagedir, pte->vpn);
+    bool dirty = pagedir_is_dirty(f->t->pagedir, pte->vpn);
+    // anonymous and modified pages go to swap and become SWAP pages,
+    // unless the page cleaner already left a current copy there
+    bool to_swap = pte->type != MEMMAP && (pte->type == SWAP || dirty);
+    size_t slot = pte->swap_slot;
+
+    // claim the frame as the page cleaner does: the clock, free_frame()
+    // and fork_frame() leave it alone until the write is done
+    f->writeback = true;
+    lock_release(&frame_lock);
+
+    // if the frame is memmaped and dirty, then write 
+    // data to the file, and evict. this only takes the inode's read
+    // lock, even past the part of the file written so far
+    if(pte->type == MEMMAP){
+        if(dirty)
+            file_write_at (page_file(pte), f->pfn, page_read_bytes(pte), \
+                page_offset(pte));
+    }
+    else if(to_swap && (dirty || slot == 0)){
+        swap_free(slot);
+        slot = swap_out(f->pfn);
+    }
+    lock_acquire(&frame_lock);
+
+    if(to_swap){
+        pte->swap_slot = slot;
+        pte->type = SWAP;
+    }
+
+    // free the frame
+    pte->mem_flag = false;
+    f->writeback = false;
+    palloc_free_page(f->pfn);
+    delete_frame(f);
+    frame_evict_cnt++;
+    cond_broadcast(&writeback_done, &frame_lock);
+    return true;
+}
+
+// page cleaner thread
+// Sleeps until the clean frames ahead of the back hand run low or
+// the back hand skips a dirty frame, then writes back dirty frames
+// that the back hand is about to reach, so that the fault path
+// finds clean victims and does not wait for the disk.
+static void page_cleaner(void *aux UNUSED){
+    for(;;){
+        sema_down(&cleaner_sema);
+        lock_acquire(&frame_lock);
+        cleaner_pending = false;
+        clean_frames();
+        lock_release(&frame_lock);
+    }
+}
+
+// Walks from cleaner_hand, the back hand or a dirty frame it
+// skipped, to the front hand, writing back dirty, unaccessed frames
+// until CLEANER_LOW_WATERMARK of them are clean.
+// Anonymous frames are written in batches of CLEANER_BATCH to
+// contiguous swap slots. Must be called with frame_lock held.
+static void clean_frames(void){
+    struct frame *batch[CLEANER_BATCH];
+    size_t batch_cnt = 0;
+    size_t clean = 0;
+    size_t from = cleaner_hand;
+    size_t span = (front_hand + frame_cnt - from) % frame_cnt;
+    size_t i;
+
+    for(i = 0; i < span && clean + batch_cnt < CLEANER_LOW_WATERMARK; i++){
+        struct frame *f = &frame_table[(from + i) % frame_cnt];
+        // accessed frames are skipped by the back hand anyway, and
+        // copy-on-write frames need one copy per process
+        if(!evictable(f) || frame_is_cow(f) || frame_accessed(f))
+            continue;
+        if(frame_is_clean(f))
+            clean++;
+        else if(f->pte->type == MEMMAP){
+            if(writeback_mmap(f)) clean++;
+        }
+        else {
+            // clear the dirty bit before copying, so that stores made
+            // during the write mark the page dirty again
+            f->writeback = true;
+            pagedir_set_dirty(f->t->pagedir, f->pte->vpn, false);
+            batch[batch_cnt++] = f;
+            if(batch_cnt == CLEANER_BATCH){
+                clean += writeback_swap(batch, batch_cnt);
+                batch_cnt = 0;
+            }
+        }
+    }
+    writeback_swap(batch, batch_cnt);
+}
+
+// Writes dirty mmapped frame F back to its file without holding
+// frame_lock during the disk transfer. F stays in memory and
+// mapped. Must be called with frame_lock held. Returns true if F
+// was written.
+static bool writeback_mmap(struct frame *f){
+    struct PTE *pte = f->pte;
+
+    f->writeback = true;
+    pagedir_set_dirty(f->t->pagedir, pte->vpn, false);
+    lock_release(&frame_lock);
+
+    bool written = (size_t)file_write_at(page_file(pte), f->pfn, \
+        page_read_bytes(pte), page_offset(pte)) == page_read_bytes(pte);
+    lock_acquire(&frame_lock);
+
+    // a failed write leaves the page dirty for the evictor
+    if(!written)
+        pagedir_set_dirty(f->t->pagedir, pte->vpn, true);
+    else
+        frame_clean_cnt++;
+    f->writeback = false;
+    cond_broadcast(&writeback_done, &frame_lock);
+    return written;
+}
+
+// Writes the CNT frames in BATCH, already marked writeback, to one
+// cluster of swap slots without holding frame_lock during the disk
+// transfer. Must be called with frame_lock held. Returns CNT.
+static size_t writeback_swap(struct frame **batch, size_t cnt){
+    void *pfns[CLEANER_BATCH];
+    size_t slots[CLEANER_BATCH];
+    size_t i;
+
+    if(cnt == 0) return 0;
+    for(i = 0; i < cnt; i++)
+        pfns[i] = batch[i]->pfn;
+
+    lock_release(&frame_lock);
+    swap_out_cluster(pfns, cnt, slots);
+    lock_acquire(&frame_lock);
+
+    for(i = 0; i < cnt; i++){
+        struct PTE *pte = batch[i]->pte;
+        swap_free(pte->swap_slot);
+        pte->swap_slot = slots[i];
+        pte->type = SWAP;
+        batch[i]->writeback = false;
+    }
+    frame_clean_cnt += cnt;
+    cond_broadcast(&writeback_done, &frame_lock);
+    return cnt;
+}
@@ -6,18 +6,33 @@
 #include "threads/synch.h"
 #include <list.h>
 
+/* Frame descriptor. Descriptors live in one array indexed by the
+   physical page, so that lookup and the clock hands never chase
+   pointers. */
 struct frame{
     void *pfn; // Physical Frame Number
     struct thread *t; // Thread that owns the frame
     struct PTE *pte; // Page Table Entry
-    struct list_elem elem; // List element for frame list
+    bool in_use; // True if the frame holds a user page
+    bool pinned; // True if the clock must not evict the frame
+    bool writeback; // True while the page cleaner writes the frame
+    struct shared_frame *share; // Sharing state, NULL if private
 };
 
-
+/* Distance between the two clock hands, "-spread=N" option. */
+extern size_t frame_hand_spread;
 
 void frame_table_init(void);
+void frame_cleaner_init(void);
+void frame_print_stats(void);
 struct frame *alloc_page_to_frame(enum palloc_flags fg);
+void unpin_frame(struct frame *f);
 struct frame *find_frame(void *pfn);
 void free_frame(void *pfn);
 bool load_to_frame(void *pfn, struct PTE *pte);
-#endif/* vm/frame.h */
\ No newline at end of file
+bool load_shared_frame(struct PTE *pte);
+bool fork_frame(struct thread *parent, struct PTE *ppte, struct PTE *cpte);
+bool cow_fault(struct PTE *pte);
+bool map_zero_frame(struct PTE *pte);
+void frame_wait_evicted(struct PTE *pte);
+#endif/* vm/frame.h */
@@ -5,76 +5,141 @@
 #include "threads/vaddr.h"
 #include "threads/malloc.h"
 
-/* Returns a hash value for page p. */
-static unsigned page_hash(const struct hash_elem *p_, void *aux UNUSED)
-{
-  const struct PTE *p = hash_entry(p_, struct PTE, elem);
-  return hash_bytes(&p->vpn, sizeof p->vpn);
+/* Returns the first page after region r. */
+static void *region_end(const struct vm_region *r) {
+  return (uint8_t *) r->start + r->page_cnt * PGSIZE;
 }
 
-/* Returns true if page a precedes page b. */
-static bool page_cmp(const struct hash_elem *a_, const struct hash_elem *b_, void *aux UNUSED) {
-  const struct PTE *a = hash_entry(a_, struct PTE, elem);
-  const struct PTE *b = hash_entry(b_, struct PTE, elem);
+/* Removes region R of the current process: releases the frames and
+   swap slots of its pages, unlinks it and frees it. */
+void page_remove_region(struct vm_region *r) {
+  uint32_t *pd = thread_current()->pagedir;
+  size_t i;
 
-  return a->vpn < b->vpn;
+  for (i = 0; i < r->page_cnt; i++) {
+    struct PTE *p = &r->pages[i];
+    // an eviction still writes through P
+    frame_wait_evicted(p);
+    free_frame(pagedir_get_page(pd, p->vpn));
+    // the zero frame is not in the frame table: unmap it here so that
+    // pagedir_destroy() does not free it
+    pagedir_clear_page(pd, p->vpn);
+    swap_free(p->swap_slot);
+  }
+  list_remove(&r->elem);
+  free(r);
 }
 
-/* destroy function */
-static void page_destroy(struct hash_elem *e, void *aux UNUSED) {
-    struct PTE *p = hash_entry(e, struct PTE, elem);
-    free_frame(pagedir_get_page (thread_current()->pagedir, p->vpn));   
-    swap_free(p->swap_slot);   
-    free(p);
+void page_table_init(struct list *pt) {
+  list_init(pt);
 }
 
-void page_table_init(struct hash *pt) {
-  hash_init(pt, page_hash, page_cmp, NULL);
+void page_table_destroy(struct list *pt) {
+  while (!list_empty(pt))
+    page_remove_region(list_entry(list_front(pt), struct vm_region, elem));
 }
 
-void page_table_destroy(struct hash *pt) {
-  hash_destroy(pt, page_destroy);
-}
+/* Copies the page table of PARENT into PT, the page table of the
+   current process, for fork().  Memory-mapped regions are not
+   inherited.  Returns false if memory runs out. */
+bool page_table_fork(struct list *pt, struct thread *parent) {
+  struct thread *cur = thread_current();
+  struct list_elem *e;
+
+  ASSERT(pt == &cur->page_table);
+  for (e = list_begin(&parent->page_table); e != list_end(&parent->page_table);
+       e = list_next(e)) {
+    struct vm_region *r = list_entry(e, struct vm_region, elem);
+    if (r->type == MEMMAP) continue;
+
+    // executable pages are read from the child's own handle of the file
+    struct vm_region *c = page_add_region(r->start, r->page_cnt, r->type, \
+      r->writable, r->file != NULL ? cur->file : NULL, r->offset, r->read_bytes);
+    if (c == NULL) return false;
 
-struct PTE *create_pte(void *vpn, pte_typ type, bool writable, struct file *file, \
-    size_t offset, size_t read_bytes, bool mem_flag) {
-  struct PTE *pte = (struct PTE *)malloc(sizeof(struct PTE));
-  if(pte == NULL) return NULL;
-  memset(pte, 0, sizeof(struct PTE));
-
-  pte->vpn = vpn;
-  pte->type = type;
-  pte->writable = writable;
-  pte->file = file;
-  pte->offset = offset;
-  pte->read_bytes = read_bytes;
-  pte->mem_flag = mem_flag;
-
-  return pte;
+    size_t i;
+    for (i = 0; i < r->page_cnt; i++) {
+      c->pages[i].type = r->pages[i].type;
+      if (!fork_frame(parent, &r->pages[i], &c->pages[i])) return false;
+    }
+  }
+  return true;
 }
 
-struct PTE *page_lookup(void *vpn) {
-  struct PTE p;
-  struct hash_elem *e;
+/* Registers PAGE_CNT pages from START in the current process as
+   one region of type TYPE.  The first READ_BYTES bytes of the
+   region come from FILE at OFFSET, the rest is zeros.  Returns
+   NULL if the range leaves user space, overlaps another region,
+   or memory runs out. */
+struct vm_region *page_add_region(void *start, size_t page_cnt, pte_typ type, \
+    bool writable, struct file *file, size_t offset, size_t read_bytes) {
+  struct list *pt = &thread_current()->page_table;
+  struct list_elem *e;
+
+  ASSERT(pg_ofs(start) == 0);
+  if (page_cnt == 0 || page_cnt > (size_t) ((uint8_t *) PHYS_BASE - (uint8_t *) start) / PGSIZE)
+    return NULL;
 
-  p.vpn = pg_round_down(vpn);
-  e = hash_find(&thread_current()->page_table, &p.elem);
-  if (e == NULL) return NULL;
-  else return hash_entry(e, struct PTE, elem);
+  // find the first region above START and check both neighbours
+  for (e = list_begin(pt); e != list_end(pt); e = list_next(e)) {
+    struct vm_region *r = list_entry(e, struct vm_region, elem);
+    if (r->start > start) break;
+    if (region_end(r) > start) return NULL;
+  }
+  if (e != list_end(pt)) {
+    struct vm_region *next = list_entry(e, struct vm_region, elem);
+    if ((uint8_t *) start + page_cnt * PGSIZE > (uint8_t *) next->start)
+      return NULL;
+  }
+
+  struct vm_region *r = malloc(sizeof *r + page_cnt * sizeof *r->pages);
+  if (r == NULL) return NULL;
+  r->start = start;
+  r->page_cnt = page_cnt;
+  r->type = type;
+  r->writable = writable;
+  r->file = file;
+  r->offset = offset;
+  r->read_bytes = read_bytes;
+
+  size_t i;
+  for (i = 0; i < page_cnt; i++) {
+    struct PTE *p = &r->pages[i];
+    p->vpn = (uint8_t *) start + i * PGSIZE;
+    p->region = r;
+    p->type = type;
+    p->swap_slot = 0;
+    p->mem_flag = false;
+  }
+  list_insert(e, &r->elem);
+  return r;
 }
 
-bool page_insert_entry(struct hash *pt, struct PTE *pte) {
-  struct hash_elem *e = &pte->elem;
-  return hash_insert(pt, e);
+/* Returns the lowest region of the current process that starts
+   above VPN, or NULL if there is none. */
+struct vm_region *page_next_region(void *vpn) {
+  struct list *pt = &thread_current()->page_table;
+  struct list_elem *e;
+
+  for (e = list_begin(pt); e != list_end(pt); e = list_next(e)) {
+    struct vm_region *r = list_entry(e, struct vm_region, elem);
+    if (r->start > vpn) return r;
+  }
+  return NULL;
 }
 
-bool page_delete_entry(struct hash *pt, struct PTE *pte) {
-  struct hash_elem *e = &pte->elem;
-  bool success = hash_delete(pt, e);
-  if(!success) return false;
-  free_frame(pagedir_get_page(thread_current()->pagedir, pte->vpn));
-  swap_free(pte->swap_slot);
-  free(pte);
-  return success;
+/* Returns the page that contains VPN in the current process, or
+   NULL if no region covers it. */
+struct PTE *page_lookup(void *vpn) {
+  struct list *pt = &thread_current()->page_table;
+  struct list_elem *e;
 
+  vpn = pg_round_down(vpn);
+  for (e = list_begin(pt); e != list_end(pt); e = list_next(e)) {
+    struct vm_region *r = list_entry(e, struct vm_region, elem);
+    if (r->start > vpn) break;
+    if (region_end(r) > vpn)
+      return &r->pages[pg_no(vpn) - pg_no(r->start)];
+  }
+  return NULL;
 }
@@ -1,47 +1,88 @@
 #ifndef VM_PAGE_H
 #define VM_PAGE_H
 
-#include <hash.h>
+#include <list.h>
 #include "threads/palloc.h"
+#include "threads/vaddr.h"
 #include "userprog/pagedir.h"
 #include "filesys/file.h"
+#include "threads/thread.h"
 
 /* Type of the page. */
 typedef enum { LOAD, SWAP, MEMMAP } pte_typ;
 
+/* State of one virtual page. PTEs live in the pages[] array of
+   their region, so they never move while the region exists. */
 struct PTE{
    void *vpn; /* Virtual page number */
+   struct vm_region *region; /* Region the page belongs to */
    pte_typ type; /* Type of the page */
-   bool writable; /* True if writable */
-
-   struct file *file; /* Reference to the file */
-   size_t offset; /* Offset of the file */
-   size_t read_bytes; /* Amount of the data written in the page */
-
    size_t swap_slot; /* Location of the swap slot */
    bool mem_flag; /* True if the page is in the memory */
+};
 
-   struct hash_elem elem; /* Hash element for page table */
-   struct list_elem mmap_elem; /* List element for mmap list */
+/* A range of virtual pages with the same backing: a segment of
+   the executable, a memory mapping, or a piece of stack. The file,
+   offset and permissions are recorded once per region. Regions
+   are kept in the thread's page_table list, sorted by address. */
+struct vm_region{
+   void *start; /* First virtual page */
+   size_t page_cnt; /* Number of pages */
+   pte_typ type; /* Type of the pages when the region was created */
+   bool writable; /* True if writable */
+   struct file *file; /* Reference to the file, NULL if anonymous */
+   size_t offset; /* Offset of the first page in the file */
+   size_t read_bytes; /* Bytes read from the file, the rest is zeros */
+   struct list_elem elem; /* List element for page table */
+   struct PTE pages[]; /* One entry per page */
 };
 
-/* These six functions are interfaces of this header. The main user
-   of this header is 'process.c', and 'syscall.c' uses this as well,
+/* These are interfaces of this header. The main user of this
+   header is 'process.c', and 'syscall.c' uses this as well,
    especially in the subroutines of lazy loading implementation.  */
 
 struct mmap_file {
    unsigned mapid; /*mapping id*/
    struct file *file; /*mapping file object*/
    struct list_elem elem; /*list element for mmap list*/
-   struct list pte_list; /*list of page table entries*/
+   struct vm_region *region; /*mapped pages*/
 };
 
-void page_table_init (struct hash *pt);
-void page_table_destroy (struct hash *pt);
-struct PTE *create_pte (void *vpn, pte_typ type, bool writable, struct file *file, \
-   size_t offset, size_t read_bytes, bool mem_flag);
+/* File backing PTE, NULL if anonymous. */
+static inline struct file *page_file (const struct PTE *pte) {
+   return pte->region->file;
+}
+
+/* Index of PTE in its region. */
+static inline size_t page_index (const struct PTE *pte) {
+   return pte - pte->region->pages;
+}
+
+/* Offset of PTE's page in its file. */
+static inline size_t page_offset (const struct PTE *pte) {
+   return pte->region->offset + page_index (pte) * PGSIZE;
+}
+
+/* Bytes of PTE's page read from its file, the rest is zeros. */
+static inline size_t page_read_bytes (const struct PTE *pte) {
+   size_t ofs = page_index (pte) * PGSIZE;
+   size_t read_bytes = pte->region->read_bytes;
+   if (read_bytes <= ofs) return 0;
+   return read_bytes - ofs < PGSIZE ? read_bytes - ofs : PGSIZE;
+}
+
+/* True if PTE's page is writable. */
+static inline bool page_writable (const struct PTE *pte) {
+   return pte->region->writable;
+}
+
+void page_table_init (struct list *pt);
+void page_table_destroy (struct list *pt);
+bool page_table_fork (struct list *pt, struct thread *parent);
+struct vm_region *page_add_region (void *start, size_t page_cnt, pte_typ type, \
+   bool writable, struct file *file, size_t offset, size_t read_bytes);
+void page_remove_region (struct vm_region *r);
+struct vm_region *page_next_region (void *vpn);
 struct PTE *page_lookup (void *vpn);
-bool page_insert_entry (struct hash *pt, struct PTE *pte);
-bool page_delete_entry (struct hash *pt, struct PTE *pte);
 
-#endif /* vm/page.h */
\ No newline at end of file
+#endif /* vm/page.h */
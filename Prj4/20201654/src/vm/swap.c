@@ -1,18 +1,61 @@
+#include <stdio.h>
 #include "vm/swap.h"
 #include "devices/block.h"
 #include "threads/vaddr.h"
 #include "threads/synch.h"
+#include "threads/palloc.h"
+
+/* Number of sectors in one swap slot (one page) */
+#define SECTORS_PER_PAGE (PGSIZE / BLOCK_SECTOR_SIZE)
 
 /* Swap table */
 struct bitmap *swap_bitmap;
 /* Swap block */
 struct block *swap_block;
-/* Swap lock */
+/* Swap lock, protects swap_bitmap and swap_cursor only. The disk
+   transfer itself runs without it. */
 struct lock swap_lock;
+/* Next slot to try. Allocation is next-fit, so pages evicted one
+   after another get neighbouring slots. */
+static size_t swap_cursor;
+
+/* Statistics. */
+static long long swap_in_cnt;  /* # of pages read from swap. */
+static long long swap_out_cnt; /* # of pages written to swap. */
+static long long swap_ra_cnt;  /* # of pages read ahead of a fault. */
 
 void swap_init(void){
-    swap_bitmap = bitmap_create(PGSIZE);
     lock_init(&swap_lock);
+    swap_cursor = 0;
+    swap_block = block_get_role(BLOCK_SWAP);
+    if(swap_block == NULL){
+        // no swap device: every allocation fails
+        swap_bitmap = bitmap_create(0);
+        return;
+    }
+    swap_bitmap = bitmap_create(block_size(swap_block) / SECTORS_PER_PAGE);
+    if(swap_bitmap == NULL)
+        PANIC("swap_init: cannot allocate swap table");
+}
+
+// Prints swap statistics.
+void swap_print_stats(void){
+    printf("Swap: %lld pages in, %lld pages out, %lld read ahead\n",
+        swap_in_cnt, swap_out_cnt, swap_ra_cnt);
+}
+
+// allocate CNT contiguous slots, next-fit from swap_cursor.
+// returns the index of the first slot.
+static size_t slot_alloc(size_t cnt){
+    lock_acquire(&swap_lock);
+    size_t idx = bitmap_scan_and_flip(swap_bitmap, swap_cursor, cnt, false);
+    if(idx == BITMAP_ERROR)
+        idx = bitmap_scan_and_flip(swap_bitmap, 0, cnt, false);
+    if(idx == BITMAP_ERROR)
+        PANIC("swap_out: out of swap slots");
+    swap_cursor = idx + cnt;
+    lock_release(&swap_lock);
+    return idx;
 }
 
 void swap_in(size_t used_index, void *pfn){
@@ -22,40 +65,81 @@ void swap_in(size_t used_index, void *pfn){
     }
     else {
         used_index -= 1;
-        swap_block = block_get_role(BLOCK_SWAP);
-        lock_acquire(&swap_lock);
-        // read from swap block (start: used_index * 8, 8 sectors)
-        for(size_t i = 0; i < 8; i++){
-            block_read(swap_block, used_index * 8 + i, pfn + \
-                i * BLOCK_SECTOR_SIZE);
-        }
+        // read the whole page in one request (start: used_index * 8, 8 sectors)
+        block_read_multiple(swap_block, used_index * SECTORS_PER_PAGE, \
+            SECTORS_PER_PAGE, pfn);
         /* Unset the read sector */
+        lock_acquire(&swap_lock);
         bitmap_set_multiple(swap_bitmap, used_index, 1, false);
+        swap_in_cnt++;
         lock_release(&swap_lock);
     }
     return;
 }
 
+// read slot USED_INDEX into PFN ahead of a fault. unlike swap_in(),
+// the slot stays allocated, so a read-ahead page that is never
+// written can be evicted again without a disk write.
+void swap_read(size_t used_index, void *pfn){
+    ASSERT(used_index != 0);
+    used_index -= 1;
+    block_read_multiple(swap_block, used_index * SECTORS_PER_PAGE, \
+        SECTORS_PER_PAGE, pfn);
+    lock_acquire(&swap_lock);
+    swap_ra_cnt++;
+    lock_release(&swap_lock);
+}
+
 // 1. select victim page
 // 2. if necessary, write to disk
 // 3. nullify the page table entry
 size_t swap_out(void *pfn){
     
     // find empty slot in swap table, and set the bit to 1
-    swap_block = block_get_role(BLOCK_SWAP);
+    size_t free_index = slot_alloc(1);
 
+    // write the whole page in one request, outside the lock
+    block_write_multiple(swap_block, free_index * SECTORS_PER_PAGE, \
+        SECTORS_PER_PAGE, pfn);
     lock_acquire(&swap_lock);
-
-    size_t free_index = bitmap_scan_and_flip(swap_bitmap, 0, 1, false);
-    for(size_t i = 0; i < 8; i++){
-        block_write(swap_block, free_index * 8 + i, pfn + \
-            i * BLOCK_SECTOR_SIZE);
-    }
+    swap_out_cnt++;
     lock_release(&swap_lock);
     free_index += 1;
     return free_index;
 }
 
+// write the CNT pages in PFNS to CNT contiguous slots, and store
+// each page's slot in SLOTS. one request per page.
+void swap_out_cluster(void **pfns, size_t cnt, size_t *slots){
+    if(cnt == 0) return;
+    size_t first = slot_alloc(cnt);
+
+    for(size_t i = 0; i < cnt; i++){
+        block_write_multiple(swap_block, (first + i) * SECTORS_PER_PAGE, \
+            SECTORS_PER_PAGE, pfns[i]);
+        slots[i] = first + i + 1;
+    }
+    lock_acquire(&swap_lock);
+    swap_out_cnt += cnt;
+    lock_release(&swap_lock);
+}
+
+// copy slot USED_INDEX to a new slot through a kernel page, for a
+// forked process. returns the new slot, or 0 if no page is free.
+size_t swap_copy(size_t used_index){
+    ASSERT(used_index != 0);
+    void *buf = palloc_get_page(0);
+    if(buf == NULL) return 0;
+    block_read_multiple(swap_block, (used_index - 1) * SECTORS_PER_PAGE, \
+        SECTORS_PER_PAGE, buf);
+    lock_acquire(&swap_lock);
+    swap_in_cnt++;
+    lock_release(&swap_lock);
+    size_t copy = swap_out(buf);
+    palloc_free_page(buf);
+    return copy;
+}
+
 void swap_free(size_t used_index){
     if(used_index == 0) return;
     used_index -= 1;
@@ -63,4 +147,4 @@ void swap_free(size_t used_index){
     bitmap_set_multiple(swap_bitmap, used_index, 1, false);
     lock_release(&swap_lock);
     return;
-}
\ No newline at end of file
+}
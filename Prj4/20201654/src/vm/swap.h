@@ -6,8 +6,12 @@
 
 
 void swap_init(void);
+void swap_print_stats(void);
 void swap_in(size_t used_index, void *pfn);
+void swap_read(size_t used_index, void *pfn);
 size_t swap_out(void *pfn);
+void swap_out_cluster(void **pfns, size_t cnt, size_t *slots);
+size_t swap_copy(size_t used_index);
 void swap_free(size_t used_index);
 
 #endif /* vm/swap.h */
\ No newline at end of file